@@ -0,0 +1,126 @@
+#import <XCTest/XCTest.h>
+
+#import "ALTActivityState.h"
+#import "ALTActivityStateRecord.h"
+#import "ALTUtil.h"
+
+static NSString * const kRecordFileName = @"AlltrackIoActivityStateRecordTest";
+// two slots of 64 bytes, the event count sits after magic, version and sequence
+static const unsigned long long kSlotSize = 64;
+static const unsigned long long kEventCountOffset = 16;
+
+@interface ALTActivityStateRecordTests : XCTestCase
+
+@end
+
+@implementation ALTActivityStateRecordTests
+
+- (void)setUp {
+  [super setUp];
+  [ALTUtil deleteFileWithName:kRecordFileName];
+}
+
+- (void)tearDown {
+  [ALTUtil deleteFileWithName:kRecordFileName];
+  [super tearDown];
+}
+
+- (ALTActivityState *)stateWithEventCount:(int)eventCount lastActivity:(double)lastActivity {
+  ALTActivityState *state = [[ALTActivityState alloc] init];
+  state.eventCount = eventCount;
+  state.sessionCount = 3;
+  state.subsessionCount = 2;
+  state.timeSpent = 40;
+  state.sessionLength = 50;
+  state.lastActivity = lastActivity;
+  return state;
+}
+
+// the process is killed without a teardown, the counters are only in the mapped pages,
+// which the next process maps again while the killed one is still mapped here
+- (void)testRestoresCountersAfterKill {
+  ALTActivityStateRecord *record = [ALTActivityStateRecord recordWithFileName:kRecordFileName];
+  XCTAssertNotNil(record);
+  [record writeCountersOfActivityState:[self stateWithEventCount:7 lastActivity:1000]];
+
+  ALTActivityStateRecord *restarted = [ALTActivityStateRecord recordWithFileName:kRecordFileName];
+  ALTActivityState *archived = [self stateWithEventCount:5 lastActivity:900];
+  XCTAssertTrue([restarted restoreCountersOfActivityState:archived]);
+  XCTAssertEqual(archived.eventCount, 7);
+  XCTAssertEqual(archived.lastActivity, 1000.0);
+}
+
+// killed half way through a slot write, the previous slot is still complete
+- (void)testTornSlotFallsBackToPreviousCounters {
+  ALTActivityStateRecord *record = [ALTActivityStateRecord recordWithFileName:kRecordFileName];
+  [record writeCountersOfActivityState:[self stateWithEventCount:1 lastActivity:1000]];
+  [record writeCountersOfActivityState:[self stateWithEventCount:2 lastActivity:1001]];
+  [record teardown];
+
+  // the second write went into slot 0, change its counters without its checksum
+  NSFileHandle *file = [NSFileHandle fileHandleForUpdatingAtPath:[ALTUtil getFilePathInAppSupportDir:kRecordFileName]];
+  [file seekToFileOffset:0 * kSlotSize + kEventCountOffset];
+  int torn = 99;
+  [file writeData:[NSData dataWithBytes:&torn length:sizeof(torn)]];
+  [file closeFile];
+
+  ALTActivityStateRecord *restarted = [ALTActivityStateRecord recordWithFileName:kRecordFileName];
+  ALTActivityState *archived = [self stateWithEventCount:0 lastActivity:0];
+  XCTAssertTrue([restarted restoreCountersOfActivityState:archived]);
+  XCTAssertEqual(archived.eventCount, 1);
+  XCTAssertEqual(archived.lastActivity, 1000.0);
+}
+
+- (void)testTruncatedFileRestoresNothing {
+  ALTActivityStateRecord *record = [ALTActivityStateRecord recordWithFileName:kRecordFileName];
+  [record writeCountersOfActivityState:[self stateWithEventCount:1 lastActivity:1000]];
+  [record teardown];
+  NSFileHandle *file = [NSFileHandle fileHandleForUpdatingAtPath:[ALTUtil getFilePathInAppSupportDir:kRecordFileName]];
+  [file truncateFileAtOffset:kSlotSize / 2];
+  [file closeFile];
+
+  ALTActivityStateRecord *restarted = [ALTActivityStateRecord recordWithFileName:kRecordFileName];
+  XCTAssertNotNil(restarted);
+  ALTActivityState *archived = [self stateWithEventCount:5 lastActivity:900];
+  XCTAssertFalse([restarted restoreCountersOfActivityState:archived]);
+  XCTAssertEqual(archived.eventCount, 5);
+}
+
+// counters written after the clock was set back are still newer than the archive
+- (void)testRestoresCountersWrittenAfterTimeTravel {
+  ALTActivityStateRecord *record = [ALTActivityStateRecord recordWithFileName:kRecordFileName];
+  ALTActivityState *state = [self stateWithEventCount:1 lastActivity:1000];
+  [record writeCountersOfActivityState:state];
+  NSData *archive = [ALTUtil archiveObject:state];
+
+  state.lastActivity = 500;
+  state.eventCount = 2;
+  [record writeCountersOfActivityState:state];
+  record = nil;
+
+  ALTActivityStateRecord *restarted = [ALTActivityStateRecord recordWithFileName:kRecordFileName];
+  ALTActivityState *archived = [ALTUtil unarchiveData:archive class:[ALTActivityState class]];
+  XCTAssertTrue([restarted restoreCountersOfActivityState:archived]);
+  XCTAssertEqual(archived.eventCount, 2);
+  XCTAssertEqual(archived.lastActivity, 500.0);
+}
+
+// the record was lost after the last archive, it must not take the archive back
+- (void)testRecordBehindArchiveIsIgnored {
+  ALTActivityStateRecord *record = [ALTActivityStateRecord recordWithFileName:kRecordFileName];
+  ALTActivityState *state = [self stateWithEventCount:1 lastActivity:1000];
+  [record writeCountersOfActivityState:state];
+  record = nil;
+
+  ALTActivityState *archived = [self stateWithEventCount:9 lastActivity:2000];
+  archived.recordGeneration = 5;
+  ALTActivityStateRecord *restarted = [ALTActivityStateRecord recordWithFileName:kRecordFileName];
+  XCTAssertFalse([restarted restoreCountersOfActivityState:archived]);
+  XCTAssertEqual(archived.eventCount, 9);
+
+  // later writes count on from the archive
+  [restarted writeCountersOfActivityState:archived];
+  XCTAssertGreaterThan(archived.recordGeneration, 5);
+}
+
+@end
@@ -0,0 +1,168 @@
+#import <XCTest/XCTest.h>
+
+#import "ALTActivityPackage.h"
+#import "ALTPackageQueueFile.h"
+#import "ALTStorageWriter.h"
+#import "ALTUtil.h"
+
+static NSString * const kQueueFileName = @"AlltrackIoPackageQueueTest";
+
+@interface ALTPackageQueueFileTests : XCTestCase
+
+// held by the test, writes of a queue file that went away are skipped
+@property (nonatomic, strong) ALTPackageQueueFile *queueFile;
+
+@end
+
+@implementation ALTPackageQueueFileTests
+
+- (void)setUp {
+  [super setUp];
+  [ALTUtil deleteFileWithName:kQueueFileName];
+  self.queueFile = [ALTPackageQueueFile queueFileWithName:kQueueFileName objectName:@"Test queue"];
+}
+
+- (void)tearDown {
+  [[ALTStorageWriter sharedWriter] flush];
+  self.queueFile = nil;
+  [ALTUtil deleteFileWithName:kQueueFileName];
+  [super tearDown];
+}
+
+- (ALTActivityPackage *)packageWithIndex:(NSUInteger)index {
+  ALTActivityPackage *package = [[ALTActivityPackage alloc] init];
+  package.path = @"/event";
+  package.suffix = [NSString stringWithFormat:@"'event%lu'", (unsigned long)index];
+  package.clientSdk = @"ios4.33.0";
+  package.parameters = [NSMutableDictionary dictionaryWithDictionary:@{
+    @"event_token": [NSString stringWithFormat:@"token%lu", (unsigned long)index],
+    @"created_at": @"2026-10-19T12:00:00.000Z+0000"
+  }];
+  return package;
+}
+
+- (void (^)(BOOL written))expectWrite {
+  XCTestExpectation *expectation = [self expectationWithDescription:@"written"];
+  return ^(BOOL written) {
+    XCTAssertTrue(written);
+    [expectation fulfill];
+  };
+}
+
+- (void)writePackages:(NSUInteger)count {
+  NSMutableArray *packages = [NSMutableArray array];
+  for (NSUInteger i = 0; i < count; i++) {
+    [packages addObject:[self packageWithIndex:i]];
+  }
+  [self.queueFile writePackages:packages completion:[self expectWrite]];
+  [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (NSString *)filePath {
+  return [ALTUtil getFilePathInAppSupportDir:kQueueFileName];
+}
+
+- (unsigned long long)fileSize {
+  return [[[NSFileManager defaultManager] attributesOfItemAtPath:[self filePath] error:nil] fileSize];
+}
+
+- (void)appendBytes:(NSData *)data {
+  NSFileHandle *file = [NSFileHandle fileHandleForUpdatingAtPath:[self filePath]];
+  [file seekToEndOfFile];
+  [file writeData:data];
+  [file closeFile];
+}
+
+// a new queue file reads the file as the next process would
+- (NSMutableArray *)restartAndReadPackages {
+  self.queueFile = [ALTPackageQueueFile queueFileWithName:kQueueFileName objectName:@"Test queue"];
+  return [self.queueFile readPackages];
+}
+
+- (void)assertPackages:(NSArray *)packages haveTokensFrom:(NSUInteger)first count:(NSUInteger)count {
+  XCTAssertEqual(packages.count, count);
+  for (NSUInteger i = 0; i < packages.count && i < count; i++) {
+    ALTActivityPackage *package = packages[i];
+    NSString *token = [NSString stringWithFormat:@"token%lu", (unsigned long)(first + i)];
+    XCTAssertEqualObjects(package.parameters[@"event_token"], token);
+  }
+}
+
+// killed in the middle of an append, the half written record is cut off
+- (void)testTornTailIsCutOff {
+  [self writePackages:3];
+  unsigned long long completeSize = [self fileSize];
+  uint32_t tornHeader[2] = { 200, 0x12345678 };
+  [self appendBytes:[NSData dataWithBytes:tornHeader length:sizeof(tornHeader)]];
+  [self appendBytes:[NSMutableData dataWithLength:20]];
+
+  [self assertPackages:[self restartAndReadPackages] haveTokensFrom:0 count:3];
+  XCTAssertEqual([self fileSize], completeSize);
+}
+
+// the file system extended the file before the data got there
+- (void)testZeroFilledTailIsDropped {
+  [self writePackages:3];
+  [self appendBytes:[NSMutableData dataWithLength:64]];
+
+  [self assertPackages:[self restartAndReadPackages] haveTokensFrom:0 count:3];
+}
+
+- (void)testDamagedRecordKeepsThePackagesBeforeIt {
+  [self writePackages:3];
+  NSMutableData *data = [NSMutableData dataWithContentsOfFile:[self filePath]];
+  // flip a byte near the end, inside the last record
+  uint8_t *bytes = data.mutableBytes;
+  bytes[data.length - 2] ^= 0xff;
+  [data writeToFile:[self filePath] atomically:YES];
+
+  [self assertPackages:[self restartAndReadPackages] haveTokensFrom:0 count:2];
+}
+
+- (void)testAppendedPackagesAreReadBack {
+  [self writePackages:2];
+  [self restartAndReadPackages];
+  [self.queueFile appendPackage:[self packageWithIndex:2] completion:[self expectWrite]];
+  [self waitForExpectationsWithTimeout:5 handler:nil];
+
+  [self assertPackages:[self restartAndReadPackages] haveTokensFrom:0 count:3];
+}
+
+// dequeues are tombstones appended to the file, they hold over a restart
+- (void)testRemovedPackagesStayRemovedAfterRestart {
+  [self writePackages:4];
+  NSMutableArray *packages = [self restartAndReadPackages];
+  unsigned long long sizeBeforeRemoval = [self fileSize];
+  XCTAssertTrue([self.queueFile removeFirstPackage:packages[0] completion:nil]);
+  XCTAssertTrue([self.queueFile removeFirstPackage:packages[1] completion:[self expectWrite]]);
+  [self waitForExpectationsWithTimeout:5 handler:nil];
+
+  // appended, not rewritten
+  XCTAssertGreaterThan([self fileSize], sizeBeforeRemoval);
+  [self assertPackages:[self restartAndReadPackages] haveTokensFrom:2 count:2];
+}
+
+- (void)testOnlyTheFirstPackageIsRemovedWithATombstone {
+  [self writePackages:2];
+  NSMutableArray *packages = [self restartAndReadPackages];
+  XCTAssertFalse([self.queueFile removeFirstPackage:packages[1] completion:nil]);
+  [self.queueFile discardRecordOfPackage:packages[0]];
+  XCTAssertFalse([self.queueFile removeFirstPackage:packages[0] completion:nil]);
+}
+
+// a torn tombstone leaves the package it removed, which is then sent again
+- (void)testTornTombstoneKeepsThePackage {
+  [self writePackages:2];
+  NSMutableArray *packages = [self restartAndReadPackages];
+  unsigned long long sizeBeforeRemoval = [self fileSize];
+  [self.queueFile removeFirstPackage:packages[0] completion:[self expectWrite]];
+  [self waitForExpectationsWithTimeout:5 handler:nil];
+
+  NSFileHandle *file = [NSFileHandle fileHandleForUpdatingAtPath:[self filePath]];
+  [file truncateFileAtOffset:sizeBeforeRemoval + 4];
+  [file closeFile];
+
+  [self assertPackages:[self restartAndReadPackages] haveTokensFrom:0 count:2];
+}
+
+@end
@@ -0,0 +1,126 @@
+#import <XCTest/XCTest.h>
+
+#import "ALTActivityPackage.h"
+#import "ALTPackageQueueFile.h"
+#import "ALTStorageWriter.h"
+#import "ALTUtil.h"
+
+// not the file of the sdk click handler, which the host app may be using
+static NSString * const kClickQueueFileName = @"AlltrackIoSdkClickQueueTest";
+
+@interface ALTSdkClickQueueTests : XCTestCase
+
+@property (nonatomic, strong) ALTPackageQueueFile *queueFile;
+
+@end
+
+@implementation ALTSdkClickQueueTests
+
+- (void)setUp {
+  [super setUp];
+  [ALTUtil deleteFileWithName:kClickQueueFileName];
+  self.queueFile = [self clickQueueFile];
+}
+
+- (void)tearDown {
+  [[ALTStorageWriter sharedWriter] flush];
+  self.queueFile = nil;
+  [ALTUtil deleteFileWithName:kClickQueueFileName];
+  [super tearDown];
+}
+
+- (ALTPackageQueueFile *)clickQueueFile {
+  return [ALTPackageQueueFile queueFileWithName:kClickQueueFileName objectName:@"Sdk click queue"];
+}
+
+- (ALTActivityPackage *)clickWithSource:(NSString *)source retries:(NSInteger)retries {
+  ALTActivityPackage *package = [[ALTActivityPackage alloc] init];
+  package.path = @"/sdk_click";
+  package.suffix = @"";
+  package.clientSdk = @"ios4.33.0";
+  package.activityKind = ALTActivityKindClick;
+  package.retries = retries;
+  package.parameters = [NSMutableDictionary dictionaryWithDictionary:@{
+    @"source": source,
+    @"click_time": @"2026-10-19T12:00:00.000Z+0000"
+  }];
+  return package;
+}
+
+// written the way the sdk click handler writes its queue: the clicks sent and still without
+// a response first, then the queued ones
+- (void)writeClicks:(NSArray *)clicks {
+  XCTestExpectation *expectation = [self expectationWithDescription:@"written"];
+  [self.queueFile writePackages:clicks
+                     completion:^(BOOL written) {
+                       XCTAssertTrue(written);
+                       [expectation fulfill];
+                     }];
+  [self waitForExpectationsWithTimeout:5 handler:nil];
+}
+
+- (NSMutableArray *)restartAndReadClicks {
+  self.queueFile = [self clickQueueFile];
+  return [self.queueFile readPackages];
+}
+
+- (void)assertClicks:(NSArray *)clicks sources:(NSArray *)sources retries:(NSArray *)retries {
+  XCTAssertEqual(clicks.count, sources.count);
+  for (NSUInteger i = 0; i < clicks.count && i < sources.count; i++) {
+    ALTActivityPackage *click = clicks[i];
+    XCTAssertEqualObjects(click.parameters[@"source"], sources[i]);
+    XCTAssertEqual(click.retries, [retries[i] integerValue]);
+    XCTAssertEqual(click.activityKind, ALTActivityKindClick);
+  }
+}
+
+- (void)testClicksKeepOrderAndRetriesAcrossRestart {
+  [self writeClicks:@[[self clickWithSource:@"deeplink" retries:2],
+                      [self clickWithSource:@"apple_ads" retries:0],
+                      [self clickWithSource:@"reftag" retries:1]]];
+
+  [self assertClicks:[self restartAndReadClicks]
+             sources:@[@"deeplink", @"apple_ads", @"reftag"]
+             retries:@[@2, @0, @1]];
+}
+
+// a click that failed again goes back to the head with one more retry, which is what the
+// next process has to find, not the retries of its earlier record
+- (void)testRetriedClickIsWrittenWithItsNewRetries {
+  NSMutableArray *clicks = [NSMutableArray arrayWithObjects:
+                            [self clickWithSource:@"deeplink" retries:0],
+                            [self clickWithSource:@"reftag" retries:0], nil];
+  [self writeClicks:clicks];
+
+  ALTActivityPackage *retried = clicks[0];
+  retried.retries++;
+  [self.queueFile discardRecordOfPackage:retried];
+  [self writeClicks:clicks];
+
+  [self assertClicks:[self restartAndReadClicks]
+             sources:@[@"deeplink", @"reftag"]
+             retries:@[@1, @0]];
+}
+
+// killed while writing the queue, the clicks completely on disk are still sent
+- (void)testTornTailKeepsCompleteClicks {
+  [self writeClicks:@[[self clickWithSource:@"deeplink" retries:1],
+                      [self clickWithSource:@"reftag" retries:0]]];
+  NSString *path = [ALTUtil getFilePathInAppSupportDir:kClickQueueFileName];
+  unsigned long long size = [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil] fileSize];
+  NSFileHandle *file = [NSFileHandle fileHandleForUpdatingAtPath:path];
+  [file truncateFileAtOffset:size - 3];
+  [file closeFile];
+
+  NSMutableArray *clicks = [self restartAndReadClicks];
+  [self assertClicks:clicks sources:@[@"deeplink"] retries:@[@1]];
+
+  // the queue written after the restart reads back whole
+  [clicks addObject:[self clickWithSource:@"apple_ads" retries:0]];
+  [self writeClicks:clicks];
+  [self assertClicks:[self restartAndReadClicks]
+             sources:@[@"deeplink", @"apple_ads"]
+             retries:@[@1, @0]];
+}
+
+@end
@@ -96,6 +96,8 @@ declare module 'react-native-alltrack' {
     public setShouldLaunchDeeplink(shouldLaunchDeeplink: boolean): void
     public deactivateSKAdNetworkHandling(): void;
     public setLinkMeEnabled(linkMeEnabled: boolean): void;
+    public setTransactionIdDedupCapacity(transactionIdDedupCapacity: number): void;
+    public setRequestBodyCompressionEnabled(requestBodyCompressionEnabled: boolean): void;
 
     public setAttributionCallbackListener(
       callback: (attribution: AlltrackAttribution) => void
@@ -282,6 +282,8 @@ var AlltrackConfig = function(appToken, environment) {
     this.allowIdfaReading = null;
     this.skAdNetworkHandling = null;
     this.linkMeEnabled = null;
+    this.transactionIdDedupCapacity = null;
+    this.requestBodyCompressionEnabled = null;
 };
 
 AlltrackConfig.EnvironmentSandbox = "sandbox";
@@ -429,6 +431,14 @@ AlltrackConfig.prototype.setLinkMeEnabled = function(linkMeEnabled) {
     this.linkMeEnabled = linkMeEnabled;
 };
 
+AlltrackConfig.prototype.setTransactionIdDedupCapacity = function(transactionIdDedupCapacity) {
+    this.transactionIdDedupCapacity = transactionIdDedupCapacity;
+};
+
+AlltrackConfig.prototype.setRequestBodyCompressionEnabled = function(requestBodyCompressionEnabled) {
+    this.requestBodyCompressionEnabled = requestBodyCompressionEnabled;
+};
+
 AlltrackConfig.prototype.setAttributionCallbackListener = function(attributionCallbackListener) {
     if (null == AlltrackConfig.AttributionSubscription) {
         module_alltrack.setAttributionCallbackListener();
@@ -4,6 +4,8 @@
 #import "ALTPackageParams.h"
 #import "ALTSessionParameters.h"
 #import "ALTThirdPartySharing.h"
+#import "ALTCommandQueue.h"
+#import "ALTStateSnapshot.h"
 
 @interface ALTInternalState : NSObject
 
@@ -51,6 +53,8 @@
 @property (nonatomic, strong) ALTTrackingStatusManager * _Nullable trackingStatusManager;
 
 - (NSString *_Nullable)adid;
+// Latest published state, read without locking.
+- (ALTStateSnapshot *_Nullable)stateSnapshot;
 
 - (id _Nullable)initWithConfig:(ALTConfig *_Nullable)alltrackConfig
                 savedPreLaunch:(ALTSavedPreLaunch * _Nullable)savedPreLaunch;
@@ -59,6 +63,7 @@
 - (void)applicationWillResignActive;
 
 - (void)trackEvent:(ALTEvent * _Nullable)event;
+- (ALTCommandQueueStats)commandQueueStats;
 
 - (void)finishedTracking:(ALTResponseData * _Nullable)responseData;
 - (void)launchEventResponseTasks:(ALTEventResponseData * _Nullable)eventResponseData;
@@ -7,7 +7,10 @@
 #import "ALTLogger.h"
 #import "ALTTimerCycle.h"
 #import "ALTTimerOnce.h"
+#import "ALTTimerWheel.h"
 #import "ALTUtil.h"
+#import "ALTLinkMatcher.h"
+#import "ALTExecutor.h"
 #import "ALTAlltrackFactory.h"
 #import "ALTAttributionHandler.h"
 #import "NSString+ALTAdditions.h"
@@ -15,6 +18,13 @@
 #import "ALTUserDefaults.h"
 #import "ALTUrlStrategy.h"
 #import "ALTSKAdNetwork.h"
+#import "ALTCommandQueue.h"
+#import "ALTActivityStateRecord.h"
+#import "ALTStateSnapshot.h"
+#import "ALTTransactionIdIndex.h"
+#import "ALTStateStore.h"
+#import "ALTAdServicesTokenCache.h"
+#import "ALTStorageWriter.h"
 
 NSString * const ALTiAdPackageKey = @"iad3";
 NSString * const ALTAdServicesPackageKey = @"apple_ads";
@@ -22,6 +32,8 @@ NSString * const ALTAdServicesPackageKey = @"apple_ads";
 typedef void (^activityHandlerBlockI)(ALTActivityHandler * activityHandler);
 
 static NSString   * const kActivityStateFilename = @"AlltrackIoActivityState";
+static NSString   * const kActivityStateRecordFilename = @"AlltrackIoActivityStateRecord";
+static NSString   * const kTransactionIdIndexFilename = @"AlltrackIoTransactionIds";
 static NSString   * const kAttributionFilename   = @"AlltrackIoAttribution";
 static NSString   * const kSessionCallbackParametersFilename   = @"AlltrackSessionCallbackParameters";
 static NSString   * const kSessionPartnerParametersFilename    = @"AlltrackSessionPartnerParameters";
@@ -34,10 +46,14 @@ static NSString   * const kDelayStartTimerName   = @"Delay Start timer";
 static NSTimeInterval kForegroundTimerInterval;
 static NSTimeInterval kForegroundTimerStart;
 static NSTimeInterval kBackgroundTimerInterval;
+static NSTimeInterval kActivityStateSafetyInterval;
 static double kSessionInterval;
 static double kSubSessionInterval;
 static const int kiAdRetriesCount = 3;
 static const int kAdServicesdRetriesCount = 1;
+static const NSUInteger kCommandQueueCapacity = 256;
+// the same link delivered again within this window is one click (cold start, user activity, RN replay)
+static const NSTimeInterval kDeeplinkDedupWindow = 2.0;
 
 @implementation ALTInternalState
 
@@ -76,6 +92,9 @@ static const int kAdServicesdRetriesCount = 1;
 @property (nonatomic, strong) ALTAttributionHandler *attributionHandler;
 @property (nonatomic, strong) ALTSdkClickHandler *sdkClickHandler;
 @property (nonatomic, strong) ALTActivityState *activityState;
+@property (nonatomic, strong) ALTActivityStateRecord *activityStateRecord;
+@property (nonatomic, strong) ALTStateSnapshotCell *stateSnapshots;
+@property (nonatomic, strong) ALTTransactionIdIndex *transactionIdIndex;
 @property (nonatomic, strong) ALTTimerCycle *foregroundTimer;
 @property (nonatomic, strong) ALTTimerOnce *backgroundTimer;
 @property (nonatomic, assign) NSInteger iAdRetriesLeft;
@@ -84,6 +103,11 @@ static const int kAdServicesdRetriesCount = 1;
 @property (nonatomic, strong) ALTPackageParams *packageParams;
 @property (nonatomic, strong) ALTTimerOnce *delayStartTimer;
 @property (nonatomic, strong) ALTSessionParameters *sessionParameters;
+@property (nonatomic, strong) ALTCommandQueue *commandQueue;
+@property (nonatomic, assign) BOOL activityStateDirty;
+@property (nonatomic, assign) double lastActivityStateWrite;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSDate *> *recentDeeplinkClicks;
+@property (nonatomic, assign) NSUInteger suppressedDeeplinkClicks;
 // weak for object that Activity Handler does not "own"
 @property (nonatomic, weak) id<ALTLogger> logger;
 @property (nonatomic, weak) NSObject<AlltrackDelegate> *alltrackDelegate;
@@ -162,7 +186,9 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
     }];
 
     // read files to have sync values available
+    self.stateSnapshots = [[ALTStateSnapshotCell alloc] init];
     [self readAttribution];
+    self.activityStateRecord = [ALTActivityStateRecord recordWithFileName:kActivityStateRecordFilename];
     [self readActivityState];
     
     // register SKAdNetwork attribution if we haven't already
@@ -189,6 +215,7 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
 
     // check if SDK is enabled/disabled
     self.internalState.enabled = savedPreLaunch.enabled != nil ? [savedPreLaunch.enabled boolValue] : YES;
+    [self publishStateSnapshot];
     // reads offline mode from pre launch
     self.internalState.offline = savedPreLaunch.offline;
     // in the background by default
@@ -214,7 +241,10 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
 
     self.trackingStatusManager = [[ALTTrackingStatusManager alloc] initWithActivityHandler:self];
 
-    self.internalQueue = dispatch_queue_create(kInternalQueueName, DISPATCH_QUEUE_SERIAL);
+    self.commandQueue = [ALTCommandQueue queueWithCapacity:kCommandQueueCapacity];
+
+    self.internalQueue = [ALTExecutor mailboxWithName:kInternalQueueName
+                                             priority:ALTExecutorPriorityHigh];
     [ALTUtil launchInQueue:self.internalQueue
                 selfInject:self
                      block:^(ALTActivityHandler * selfI) {
@@ -237,47 +267,41 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
 - (void)applicationDidBecomeActive {
     self.internalState.background = NO;
 
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI delayStartI:selfI];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI delayStartI:selfI];
 
-                         [selfI stopBackgroundTimerI:selfI];
+        [selfI stopBackgroundTimerI:selfI];
 
-                         [selfI startForegroundTimerI:selfI];
+        [selfI startForegroundTimerI:selfI];
 
-                         [selfI.logger verbose:@"Subsession start"];
+        [selfI.logger verbose:@"Subsession start"];
 
-                         [selfI startI:selfI];
-                     }];
+        [selfI startI:selfI];
+    }];
 }
 
 - (void)applicationWillResignActive {
     self.internalState.background = YES;
 
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI stopForegroundTimerI:selfI];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI stopForegroundTimerI:selfI];
 
-                         [selfI startBackgroundTimerI:selfI];
+        [selfI startBackgroundTimerI:selfI];
 
-                         [selfI.logger verbose:@"Subsession end"];
+        [selfI.logger verbose:@"Subsession end"];
 
-                         [selfI endI:selfI];
-                     }];
+        [selfI endI:selfI];
+    }];
 }
 
 - (void)trackEvent:(ALTEvent *)event {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         // track event called before app started
-                         if (selfI.activityState == nil) {
-                             [selfI startI:selfI];
-                         }
-                         [selfI eventI:selfI event:event];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI trackEventI:selfI event:event];
+    }];
+}
+
+- (ALTCommandQueueStats)commandQueueStats {
+    return [self.commandQueue stats];
 }
 
 - (void)finishedTracking:(ALTResponseData *)responseData {
@@ -303,106 +327,113 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
 }
 
 - (void)launchEventResponseTasks:(ALTEventResponseData *)eventResponseData {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI launchEventResponseTasksI:selfI eventResponseData:eventResponseData];
-                     }];
+    [ALTUtil launchInOwnQueue:self.internalQueue
+                   selfInject:self
+                        block:^(ALTActivityHandler * selfI) {
+                            [selfI launchEventResponseTasksI:selfI eventResponseData:eventResponseData];
+                        }];
 }
 
 - (void)launchSessionResponseTasks:(ALTSessionResponseData *)sessionResponseData {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI launchSessionResponseTasksI:selfI sessionResponseData:sessionResponseData];
-                     }];
+    [ALTUtil launchInOwnQueue:self.internalQueue
+                   selfInject:self
+                        block:^(ALTActivityHandler * selfI) {
+                            [selfI launchSessionResponseTasksI:selfI sessionResponseData:sessionResponseData];
+                        }];
 }
 
 - (void)launchSdkClickResponseTasks:(ALTSdkClickResponseData *)sdkClickResponseData {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI launchSdkClickResponseTasksI:selfI sdkClickResponseData:sdkClickResponseData];
-                     }];
+    [ALTUtil launchInOwnQueue:self.internalQueue
+                   selfInject:self
+                        block:^(ALTActivityHandler * selfI) {
+                            [selfI launchSdkClickResponseTasksI:selfI sdkClickResponseData:sdkClickResponseData];
+                        }];
 }
 
 - (void)launchAttributionResponseTasks:(ALTAttributionResponseData *)attributionResponseData {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI launchAttributionResponseTasksI:selfI attributionResponseData:attributionResponseData];
-                     }];
+    [ALTUtil launchInOwnQueue:self.internalQueue
+                   selfInject:self
+                        block:^(ALTActivityHandler * selfI) {
+                            [selfI launchAttributionResponseTasksI:selfI attributionResponseData:attributionResponseData];
+                        }];
 }
 
 - (void)setEnabled:(BOOL)enabled {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI setEnabledI:selfI enabled:enabled];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI setEnabledI:selfI enabled:enabled];
+    }];
 }
 
 - (void)setOfflineMode:(BOOL)offline {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI setOfflineModeI:selfI offline:offline];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI setOfflineModeI:selfI offline:offline];
+    }];
 }
 
 - (BOOL)isEnabled {
-    return [self isEnabledI:self];
+    ALTStateSnapshot *snapshot = [self.stateSnapshots current];
+    if (snapshot == nil) {
+        return [self isEnabledI:self];
+    }
+    return snapshot.enabled;
 }
 
 - (BOOL)isGdprForgotten {
-    return [self isGdprForgottenI:self];
+    ALTStateSnapshot *snapshot = [self.stateSnapshots current];
+    if (snapshot == nil) {
+        return [self isGdprForgottenI:self];
+    }
+    return snapshot.isGdprForgotten;
 }
 
 - (NSString *)adid {
-    if (self.activityState == nil) {
-        return nil;
+    ALTStateSnapshot *snapshot = [self.stateSnapshots current];
+    if (snapshot == nil) {
+        if (self.activityState == nil) {
+            return nil;
+        }
+        return self.activityState.adid;
     }
-    return self.activityState.adid;
+    return snapshot.adid;
+}
+
+- (ALTStateSnapshot *)stateSnapshot {
+    return [self.stateSnapshots current];
+}
+
+- (void)setAttribution:(ALTAttribution *)attribution {
+    _attribution = [attribution copy];
+    [self publishStateSnapshot];
 }
 
 - (void)appWillOpenUrl:(NSURL *)url withClickTime:(NSDate *)clickTime {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI appWillOpenUrlI:selfI url:url clickTime:clickTime];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI appWillOpenUrlI:selfI url:url clickTime:clickTime];
+    }];
 }
 
 - (void)setDeviceToken:(NSData *)deviceToken {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI setDeviceTokenI:selfI deviceToken:deviceToken];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI setDeviceTokenI:selfI deviceToken:deviceToken];
+    }];
 }
 
 - (void)setPushToken:(NSString *)pushToken {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI setPushTokenI:selfI pushToken:pushToken];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI setPushTokenI:selfI pushToken:pushToken];
+    }];
 }
 
 - (void)setGdprForgetMe {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI setGdprForgetMeI:selfI];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI setGdprForgetMeI:selfI];
+    }];
 }
 
 - (void)setTrackingStateOptedOut {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI setTrackingStateOptedOutI:selfI];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI setTrackingStateOptedOutI:selfI];
+    }];
 }
 
 - (void)setAdServicesAttributionToken:(NSString *)token
@@ -414,10 +445,11 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
         if (error.code != 3 && self.adServicesRetriesLeft > 0) {
             self.adServicesRetriesLeft = self.adServicesRetriesLeft - 1;
             // retry after 5 seconds
-            dispatch_time_t retryTime = dispatch_time(DISPATCH_TIME_NOW, 5 * NSEC_PER_SEC);
-            dispatch_after(retryTime, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            [[ALTTimerWheel sharedWheel] scheduleBlock:^{
                 [self checkForAdServicesAttributionI:self];
-            });
+            }
+                                                 queue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)
+                                                 after:5];
         } else {
             [self sendAdServicesClickPackage:self
                                       token:nil
@@ -467,10 +499,11 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
                         break;
                 }
                 self.iAdRetriesLeft = self.iAdRetriesLeft - 1;
-                dispatch_time_t retryTime = dispatch_time(DISPATCH_TIME_NOW, iAdRetryDelay);
-                dispatch_after(retryTime, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                [[ALTTimerWheel sharedWheel] scheduleBlock:^{
                     [self checkForiAdI:self];
-                });
+                }
+                                                     queue:dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0)
+                                                     after:(NSTimeInterval)iAdRetryDelay / NSEC_PER_SEC];
                 return;
             }
             case AltADClientErrorTrackingRestrictedOrDenied:
@@ -493,30 +526,26 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
         // send immediately
         [self sendIad3ClickPackage:self attributionDetails:attributionDetails];
         // save in the background queue
-        [ALTUtil launchInQueue:self.internalQueue
-                    selfInject:self
-                         block:^(ALTActivityHandler * selfI) {
-                             [selfI saveAttributionDetailsI:selfI
-                                         attributionDetails:attributionDetails];
+        [self launchCommand:^(ALTActivityHandler * selfI) {
+            [selfI saveAttributionDetailsI:selfI
+                        attributionDetails:attributionDetails];
 
-                         }];
+        }];
         return;
     }
 
     // check if new updates previous written one
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         if ([attributionDetails isEqualToDictionary:selfI.activityState.attributionDetails]) {
-                             return;
-                         }
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        if ([attributionDetails isEqualToDictionary:selfI.activityState.attributionDetails]) {
+            return;
+        }
 
-                         [selfI sendIad3ClickPackage:selfI attributionDetails:attributionDetails];
+        [selfI sendIad3ClickPackage:selfI attributionDetails:attributionDetails];
 
-                         // save new iAd details
-                         [selfI saveAttributionDetailsI:selfI
-                                     attributionDetails:attributionDetails];
-                     }];
+        // save new iAd details
+        [selfI saveAttributionDetailsI:selfI
+                    attributionDetails:attributionDetails];
+    }];
 }
 
 - (void)saveiAdErrorCode:(NSInteger)code {
@@ -626,116 +655,88 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
 }
 
 - (void)setAskingAttribution:(BOOL)askingAttribution {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI setAskingAttributionI:selfI
-                                   askingAttribution:askingAttribution];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI setAskingAttributionI:selfI
+                  askingAttribution:askingAttribution];
+    }];
 }
 
 - (void)foregroundTimerFired {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI foregroundTimerFiredI:selfI];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI foregroundTimerFiredI:selfI];
+    }];
 }
 
 - (void)backgroundTimerFired {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI backgroundTimerFiredI:selfI];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI backgroundTimerFiredI:selfI];
+    }];
 }
 
 - (void)sendFirstPackages {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI sendFirstPackagesI:selfI];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI sendFirstPackagesI:selfI];
+    }];
 }
 
 - (void)addSessionCallbackParameter:(NSString *)key
                               value:(NSString *)value {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI addSessionCallbackParameterI:selfI key:key value:value];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI addSessionCallbackParameterI:selfI key:key value:value];
+    }];
 }
 
 - (void)addSessionPartnerParameter:(NSString *)key
                              value:(NSString *)value {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI addSessionPartnerParameterI:selfI key:key value:value];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI addSessionPartnerParameterI:selfI key:key value:value];
+    }];
 }
 
 - (void)removeSessionCallbackParameter:(NSString *)key {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI removeSessionCallbackParameterI:selfI key:key];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI removeSessionCallbackParameterI:selfI key:key];
+    }];
 }
 
 - (void)removeSessionPartnerParameter:(NSString *)key {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI removeSessionPartnerParameterI:selfI key:key];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI removeSessionPartnerParameterI:selfI key:key];
+    }];
 }
 
 - (void)resetSessionCallbackParameters {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI resetSessionCallbackParametersI:selfI];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI resetSessionCallbackParametersI:selfI];
+    }];
 }
 
 - (void)resetSessionPartnerParameters {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI resetSessionPartnerParametersI:selfI];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI resetSessionPartnerParametersI:selfI];
+    }];
 }
 
 - (void)trackAdRevenue:(NSString *)source payload:(NSData *)payload {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI adRevenueI:selfI source:source payload:payload];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI adRevenueI:selfI source:source payload:payload];
+    }];
 }
 
 - (void)trackSubscription:(ALTSubscription *)subscription {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
+    [self launchCommand:^(ALTActivityHandler * selfI) {
         [selfI trackSubscriptionI:selfI subscription:subscription];
     }];
 }
 
 - (void)disableThirdPartySharing {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI disableThirdPartySharingI:selfI];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI disableThirdPartySharingI:selfI];
+    }];
 }
 
 - (void)trackThirdPartySharing:(nonnull ALTThirdPartySharing *)thirdPartySharing {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
+    [self launchCommand:^(ALTActivityHandler * selfI) {
         BOOL tracked =
             [selfI trackThirdPartySharingI:selfI thirdPartySharing:thirdPartySharing];
         if (! tracked) {
@@ -751,9 +752,7 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
 }
 
 - (void)trackMeasurementConsent:(BOOL)enabled {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
+    [self launchCommand:^(ALTActivityHandler * selfI) {
         BOOL tracked =
             [selfI trackMeasurementConsentI:selfI enabled:enabled];
         if (! tracked) {
@@ -764,35 +763,27 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
 }
 
 - (void)trackAdRevenue:(ALTAdRevenue *)adRevenue {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
+    [self launchCommand:^(ALTActivityHandler * selfI) {
         [selfI trackAdRevenueI:selfI adRevenue:adRevenue];
     }];
 }
 
 - (void)checkForNewAttStatus {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
+    [self launchCommand:^(ALTActivityHandler * selfI) {
         [selfI checkForNewAttStatusI:selfI];
     }];
 }
 
 - (void)writeActivityState {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                         [selfI writeActivityStateI:selfI];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI writeActivityStateI:selfI];
+    }];
 }
 
 - (void)trackAttStatusUpdate {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTActivityHandler * selfI) {
-                        [selfI trackAttStatusUpdateI:selfI];
-                     }];
+    [self launchCommand:^(ALTActivityHandler * selfI) {
+        [selfI trackAttStatusUpdateI:selfI];
+    }];
 }
 - (void)trackAttStatusUpdateI:(ALTActivityHandler *)selfI {
     double now = [NSDate.date timeIntervalSince1970];
@@ -864,13 +855,24 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
     self.alltrackDelegate = nil;
     self.alltrackConfig = nil;
     self.internalState = nil;
+    [self.stateSnapshots publish:nil];
     self.packageParams = nil;
     self.delayStartTimer = nil;
+    self.commandQueue = nil;
+    self.transactionIdIndex = nil;
+    [self.activityStateRecord teardown];
+    self.activityStateRecord = nil;
     self.logger = nil;
 }
 
 + (void)deleteState
 {
+    [[ALTStateStore sharedStore] performTransaction:^(ALTStateStoreTransaction *transaction) {
+        [transaction removeObjectForKey:kActivityStateFilename];
+        [transaction removeObjectForKey:kAttributionFilename];
+        [transaction removeObjectForKey:kSessionCallbackParametersFilename];
+        [transaction removeObjectForKey:kSessionPartnerParametersFilename];
+    }];
     [ALTActivityHandler deleteActivityState];
     [ALTActivityHandler deleteAttribution];
     [ALTActivityHandler deleteSessionCallbackParameter];
@@ -880,18 +882,26 @@ typedef NS_ENUM(NSInteger, AltADClientError) {
 }
 
 + (void)deleteActivityState {
+    [[ALTStateStore sharedStore] removeObjectForKey:kActivityStateFilename];
     [ALTUtil deleteFileWithName:kActivityStateFilename];
+    [ALTUtil deleteFileWithName:kActivityStateRecordFilename];
+    // a pending index write would bring the file back
+    [[ALTStorageWriter sharedWriter] flush];
+    [ALTUtil deleteFileWithName:kTransactionIdIndexFilename];
 }
 
 + (void)deleteAttribution {
+    [[ALTStateStore sharedStore] removeObjectForKey:kAttributionFilename];
     [ALTUtil deleteFileWithName:kAttributionFilename];
 }
 
 + (void)deleteSessionCallbackParameter {
+    [[ALTStateStore sharedStore] removeObjectForKey:kSessionCallbackParametersFilename];
     [ALTUtil deleteFileWithName:kSessionCallbackParametersFilename];
 }
 
 + (void)deleteSessionPartnerParameter {
+    [[ALTStateStore sharedStore] removeObjectForKey:kSessionPartnerParametersFilename];
     [ALTUtil deleteFileWithName:kSessionPartnerParametersFilename];
 }
 
@@ -906,6 +916,8 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
     kForegroundTimerStart = ALTAlltrackFactory.timerStart;
     kForegroundTimerInterval = ALTAlltrackFactory.timerInterval;
     kBackgroundTimerInterval = ALTAlltrackFactory.timerInterval;
+    // persist foreground time at least this often, well below the session interval
+    kActivityStateSafetyInterval = MIN(10 * 60, kSessionInterval / 2);
 
     selfI.packageParams = [ALTPackageParams packageParamsWithSdkPrefix:selfI.alltrackConfig.sdkPrefix];
 
@@ -913,6 +925,9 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
     selfI.sessionParameters = [[ALTSessionParameters alloc] init];
     [selfI readSessionCallbackParametersI:selfI];
     [selfI readSessionPartnerParametersI:selfI];
+    selfI.transactionIdIndex = [ALTTransactionIdIndex
+                                indexWithFileName:kTransactionIdIndexFilename
+                                capacity:selfI.alltrackConfig.transactionIdDedupCapacity];
 
     if (selfI.alltrackConfig.eventBufferingEnabled)  {
         [selfI.logger info:@"Event buffering is enabled"];
@@ -1130,7 +1145,7 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
                                         block:^{
             selfI.activityState.lastActivity = now;
         }];
-        [selfI writeActivityStateI:selfI];
+        [selfI writeActivityCountersI:selfI];
         return;
     }
 
@@ -1151,7 +1166,7 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
         [selfI.logger verbose:@"Started subsession %d of session %d",
          selfI.activityState.subsessionCount,
          selfI.activityState.sessionCount];
-        [selfI writeActivityStateI:selfI];
+        [selfI writeActivityCountersI:selfI];
         return;
     }
 
@@ -1237,9 +1252,48 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
     double now = [NSDate.date timeIntervalSince1970];
     if ([selfI updateActivityStateI:selfI now:now]) {
         [selfI writeActivityStateI:selfI];
+    } else {
+        [selfI writeActivityStateIfDirtyI:selfI];
+    }
+}
+
+// Public calls go through one ring, so they are handled in the order they were made.
+// Only the call that finds no drain scheduled dispatches one, a burst of calls costs one hop.
+- (void)launchCommand:(void (^)(ALTActivityHandler * selfI))command {
+    if ([self.commandQueue enqueue:[command copy]]) {
+        [self scheduleCommandQueueDrain];
     }
 }
 
+- (void)scheduleCommandQueueDrain {
+    [ALTUtil launchInQueue:self.internalQueue
+                selfInject:self
+                     block:^(ALTActivityHandler * selfI) {
+                         [selfI drainCommandQueueI:selfI];
+                     }];
+}
+
+- (void)drainCommandQueueI:(ALTActivityHandler *)selfI {
+    BOOL remaining = [selfI.commandQueue drainWithLimit:[selfI.commandQueue capacity]
+                                                  block:^(id command) {
+                                                      void (^block)(ALTActivityHandler *) = command;
+                                                      block(selfI);
+                                                  }];
+    // let other work on the queue run between full batches
+    if (remaining) {
+        [selfI scheduleCommandQueueDrain];
+    }
+}
+
+- (void)trackEventI:(ALTActivityHandler *)selfI
+              event:(ALTEvent *)event {
+    // track event called before app started
+    if (selfI.activityState == nil) {
+        [selfI startI:selfI];
+    }
+    [selfI eventI:selfI event:event];
+}
+
 - (void)eventI:(ALTActivityHandler *)selfI
          event:(ALTEvent *)event {
     if (![selfI isEnabledI:selfI]) return;
@@ -1278,7 +1332,12 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
         [selfI startBackgroundTimerI:selfI];
     }
 
-    [selfI writeActivityStateI:selfI];
+    // the transaction id goes into the archive, everything else fits the record
+    if (event.transactionId != nil) {
+        [selfI writeActivityStateI:selfI];
+    } else {
+        [selfI writeActivityCountersI:selfI];
+    }
 }
 
 - (void)adRevenueI:(ALTActivityHandler *)selfI
@@ -1532,6 +1591,8 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
 
 - (void)launchEventResponseTasksI:(ALTActivityHandler *)selfI
                 eventResponseData:(ALTEventResponseData *)eventResponseData {
+    [selfI logResponseLatencyI:selfI responseData:eventResponseData];
+
     [selfI updateAdidI:selfI adid:eventResponseData.adid];
 
     // event success callback
@@ -1558,6 +1619,8 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
 
 - (void)launchSessionResponseTasksI:(ALTActivityHandler *)selfI
                 sessionResponseData:(ALTSessionResponseData *)sessionResponseData {
+    [selfI logResponseLatencyI:selfI responseData:sessionResponseData];
+
     [selfI updateAdidI:selfI adid:sessionResponseData.adid];
 
     BOOL toLaunchAttributionDelegate = [selfI updateAttributionI:selfI attribution:sessionResponseData.attribution];
@@ -1604,6 +1667,8 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
 
 - (void)launchSdkClickResponseTasksI:(ALTActivityHandler *)selfI
                 sdkClickResponseData:(ALTSdkClickResponseData *)sdkClickResponseData {
+    [selfI logResponseLatencyI:selfI responseData:sdkClickResponseData];
+
     [selfI updateAdidI:selfI adid:sdkClickResponseData.adid];
 
     BOOL toLaunchAttributionDelegate = [selfI updateAttributionI:selfI attribution:sdkClickResponseData.attribution];
@@ -1619,6 +1684,8 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
 
 - (void)launchAttributionResponseTasksI:(ALTActivityHandler *)selfI
                 attributionResponseData:(ALTAttributionResponseData *)attributionResponseData {
+    [selfI logResponseLatencyI:selfI responseData:attributionResponseData];
+
     [selfI checkConversionValue:attributionResponseData];
 
     [selfI updateAdidI:selfI adid:attributionResponseData.adid];
@@ -1723,6 +1790,7 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
 
     // save new enabled state in internal state
     selfI.internalState.enabled = enabled;
+    [selfI publishStateSnapshot];
 
     if (selfI.activityState == nil) {
         [selfI checkStatusI:selfI
@@ -1815,11 +1883,10 @@ preLaunchActions:(ALTSavedPreLaunch*)preLaunchActions
 - (void)checkForAdServicesAttributionI:(ALTActivityHandler *)selfI {
     if (@available(iOS 14.3, tvOS 14.3, *)) {
         if ([selfI shouldFetchAdServicesI:selfI]) {
-            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
-                NSError *error = nil;
-                NSString *token = [ALTUtil fetchAdServicesAttribution:&error];
+            // also warms the token the sdk_click queue patches into the click at send time
+            [[ALTAdServicesTokenCache sharedCache] tokenWithCompletion:^(NSString *token, NSError *error) {
                 [selfI setAdServicesAttributionToken:token error:error];
-            });
+            }];
         }
     }
 }
@@ -1913,12 +1980,13 @@ remainsPausedMessage:(NSString *)remainsPausedMessage
     if (![ALTUtil isDeeplinkValid:url]) {
         return;
     }
-
-    NSArray *queryArray = [url.query componentsSeparatedByString:@"&"];
-    if (queryArray == nil) {
-        queryArray = @[];
+    if ([selfI isRepeatedDeeplinkI:selfI url:url clickTime:clickTime]) {
+        return;
     }
 
+    // only the alltrack_ pairs are copied out of the query and decoded
+    NSArray *queryArray = [ALTLinkMatcher pairsWithKeyPrefix:kAlltrackPrefix inQuery:url.query];
+
     NSMutableDictionary *alltrackDeepLinks = [NSMutableDictionary dictionary];
     ALTAttribution *deeplinkAttribution = [[ALTAttribution alloc] init];
     for (NSString *fieldValuePair in queryArray) {
@@ -1948,6 +2016,41 @@ remainsPausedMessage:(NSString *)remainsPausedMessage
     [selfI.sdkClickHandler sendSdkClick:clickPackage];
 }
 
+- (BOOL)isRepeatedDeeplinkI:(ALTActivityHandler *)selfI
+                        url:(NSURL *)url
+                  clickTime:(NSDate *)clickTime
+{
+    // scheme and host are case insensitive, the rest of the link is kept as it is
+    NSURLComponents *components = [NSURLComponents componentsWithURL:url resolvingAgainstBaseURL:NO];
+    components.scheme = [components.scheme lowercaseString];
+    components.host = [components.host lowercaseString];
+    NSString *normalizedUrl = components.string ?: url.absoluteString;
+    NSDate *time = clickTime ?: [NSDate date];
+
+    if (selfI.recentDeeplinkClicks == nil) {
+        selfI.recentDeeplinkClicks = [NSMutableDictionary dictionary];
+    }
+    NSDate *previousTime = [selfI.recentDeeplinkClicks objectForKey:normalizedUrl];
+    if (previousTime != nil && fabs([time timeIntervalSinceDate:previousTime]) < kDeeplinkDedupWindow) {
+        selfI.suppressedDeeplinkClicks++;
+        [selfI.logger debug:@"Skipping deep link opened again within %.1f seconds, %lu skipped so far",
+         kDeeplinkDedupWindow, (unsigned long)selfI.suppressedDeeplinkClicks];
+        return YES;
+    }
+
+    // only clicks inside the window can still be repeated
+    NSMutableArray<NSString *> *expiredUrls = [NSMutableArray array];
+    for (NSString *recentUrl in selfI.recentDeeplinkClicks) {
+        NSDate *recentTime = [selfI.recentDeeplinkClicks objectForKey:recentUrl];
+        if (fabs([time timeIntervalSinceDate:recentTime]) >= kDeeplinkDedupWindow) {
+            [expiredUrls addObject:recentUrl];
+        }
+    }
+    [selfI.recentDeeplinkClicks removeObjectsForKeys:expiredUrls];
+    [selfI.recentDeeplinkClicks setObject:time forKey:normalizedUrl];
+    return NO;
+}
+
 - (BOOL)readDeeplinkQueryStringI:(ALTActivityHandler *)selfI
                      queryString:(NSString *)queryString
                  alltrackDeepLinks:(NSMutableDictionary*)alltrackDeepLinks
@@ -2216,6 +2319,19 @@ remainsPausedMessage:(NSString *)remainsPausedMessage
 }
 
 #pragma mark - private
+- (void)logResponseLatencyI:(ALTActivityHandler *)selfI
+               responseData:(ALTResponseData *)responseData {
+    [responseData markStage:ALTResponseStageActivity];
+
+    NSTimeInterval latency = [responseData secondsFromStage:ALTResponseStageReceived
+                                                    toStage:ALTResponseStageActivity];
+    if (latency < 0) {
+        return;
+    }
+    [selfI.logger verbose:@"%@ response reached the activity handler in %@ seconds",
+     [ALTActivityKindUtil activityKindToString:responseData.activityKind],
+     [ALTUtil secondsNumberFormat:latency]];
+}
 
 - (BOOL)isEnabledI:(ALTActivityHandler *)selfI {
     if (selfI.activityState != nil) {
@@ -2277,13 +2393,43 @@ remainsPausedMessage:(NSString *)remainsPausedMessage
         if (selfI.activityState == nil) {
             return;
         }
-        [ALTUtil writeObject:selfI.activityState
-                    fileName:kActivityStateFilename
-                  objectName:@"Activity state"
-                  syncObject:[ALTActivityState class]];
+        // record first, so that it is never behind the archive
+        [selfI.activityStateRecord writeCountersOfActivityState:selfI.activityState];
+        [[ALTStateStore sharedStore] setObject:selfI.activityState
+                                        forKey:kActivityStateFilename
+                                    objectName:@"Activity state"];
+        [selfI publishStateSnapshot];
+        selfI.activityStateDirty = NO;
+        selfI.lastActivityStateWrite = [NSDate.date timeIntervalSince1970];
     }];
 }
 
+- (void)writeActivityCountersI:(ALTActivityHandler *)selfI
+{
+    if (selfI.activityStateRecord == nil) {
+        [selfI writeActivityStateI:selfI];
+        return;
+    }
+    [ALTUtil launchSynchronisedWithObject:[ALTActivityState class]
+                                    block:^{
+        if (selfI.activityState == nil) {
+            return;
+        }
+        [selfI.activityStateRecord writeCountersOfActivityState:selfI.activityState];
+        [selfI.activityStateRecord flush];
+        // the archive catches up on the next transition
+        selfI.activityStateDirty = YES;
+    }];
+}
+
+- (void)writeActivityStateIfDirtyI:(ALTActivityHandler *)selfI
+{
+    if (!selfI.activityStateDirty) {
+        return;
+    }
+    [selfI writeActivityStateI:selfI];
+}
+
 - (void)teardownActivityStateS
 {
     @synchronized ([ALTActivityState class]) {
@@ -2299,10 +2445,9 @@ remainsPausedMessage:(NSString *)remainsPausedMessage
         if (selfI.attribution == nil) {
             return;
         }
-        [ALTUtil writeObject:selfI.attribution
-                    fileName:kAttributionFilename
-                  objectName:@"Attribution"
-                  syncObject:[ALTAttribution class]];
+        [[ALTStateStore sharedStore] setObject:selfI.attribution
+                                        forKey:kAttributionFilename
+                                    objectName:@"Attribution"];
     }
 }
 
@@ -2320,18 +2465,36 @@ remainsPausedMessage:(NSString *)remainsPausedMessage
     [ALTUtil launchSynchronisedWithObject:[ALTActivityState class]
                                     block:^{
         [NSKeyedUnarchiver setClass:[ALTActivityState class] forClassName:@"AIActivityState"];
-        self.activityState = [ALTUtil readObject:kActivityStateFilename
-                                      objectName:@"Activity state"
-                                           class:[ALTActivityState class]
-                                      syncObject:[ALTActivityState class]];
+        self.activityState = [[ALTStateStore sharedStore] objectForKey:kActivityStateFilename
+                                                                 class:[ALTActivityState class]
+                                                            objectName:@"Activity state"
+                                                            syncObject:[ALTActivityState class]];
+        // counters written in place after the last archive
+        if ([self.activityStateRecord restoreCountersOfActivityState:self.activityState]) {
+            [self.logger verbose:@"Restored activity state counters from record"];
+        }
+        [self publishStateSnapshot];
+    }];
+}
+
+- (void)publishStateSnapshot {
+    // writers still serialise on the activity state, only readers go without locks
+    [ALTUtil launchSynchronisedWithObject:[ALTActivityState class]
+                                    block:^{
+        ALTStateSnapshot *snapshot = [[ALTStateSnapshot alloc]
+                                      initWithAdid:self.activityState.adid
+                                      attribution:self.attribution
+                                      enabled:[self isEnabledI:self]
+                                      isGdprForgotten:[self isGdprForgottenI:self]];
+        [self.stateSnapshots publish:snapshot];
     }];
 }
 
 - (void)readAttribution {
-    self.attribution = [ALTUtil readObject:kAttributionFilename
-                                objectName:@"Attribution"
-                                     class:[ALTAttribution class]
-                                syncObject:[ALTAttribution class]];
+    self.attribution = [[ALTStateStore sharedStore] objectForKey:kAttributionFilename
+                                                           class:[ALTAttribution class]
+                                                      objectName:@"Attribution"
+                                                      syncObject:[ALTAttribution class]];
 }
 
 - (void)writeSessionCallbackParametersI:(ALTActivityHandler *)selfI {
@@ -2339,10 +2502,9 @@ remainsPausedMessage:(NSString *)remainsPausedMessage
         if (selfI.sessionParameters == nil) {
             return;
         }
-        [ALTUtil writeObject:selfI.sessionParameters.callbackParameters
-                    fileName:kSessionCallbackParametersFilename
-                  objectName:@"Session Callback parameters"
-                  syncObject:[ALTSessionParameters class]];
+        [[ALTStateStore sharedStore] setObject:selfI.sessionParameters.callbackParameters
+                                        forKey:kSessionCallbackParametersFilename
+                                    objectName:@"Session Callback parameters"];
     }
 }
 
@@ -2351,10 +2513,9 @@ remainsPausedMessage:(NSString *)remainsPausedMessage
         if (selfI.sessionParameters == nil) {
             return;
         }
-        [ALTUtil writeObject:selfI.sessionParameters.partnerParameters
-                    fileName:kSessionPartnerParametersFilename
-                  objectName:@"Session Partner parameters"
-                  syncObject:[ALTSessionParameters class]];
+        [[ALTStateStore sharedStore] setObject:selfI.sessionParameters.partnerParameters
+                                        forKey:kSessionPartnerParametersFilename
+                                    objectName:@"Session Partner parameters"];
     }
 }
 
@@ -2370,17 +2531,19 @@ remainsPausedMessage:(NSString *)remainsPausedMessage
 }
 
 - (void)readSessionCallbackParametersI:(ALTActivityHandler *)selfI {
-    selfI.sessionParameters.callbackParameters = [ALTUtil readObject:kSessionCallbackParametersFilename
-                                                         objectName:@"Session Callback parameters"
-                                                              class:[NSDictionary class]
-                                                         syncObject:[ALTSessionParameters class]];
+    selfI.sessionParameters.callbackParameters = [[ALTStateStore sharedStore]
+                                                  objectForKey:kSessionCallbackParametersFilename
+                                                  class:[NSDictionary class]
+                                                  objectName:@"Session Callback parameters"
+                                                  syncObject:[ALTSessionParameters class]];
 }
 
 - (void)readSessionPartnerParametersI:(ALTActivityHandler *)selfI {
-    selfI.sessionParameters.partnerParameters = [ALTUtil readObject:kSessionPartnerParametersFilename
-                                                        objectName:@"Session Partner parameters"
-                                                             class:[NSDictionary class]
-                                                        syncObject:[ALTSessionParameters class]];
+    selfI.sessionParameters.partnerParameters = [[ALTStateStore sharedStore]
+                                                 objectForKey:kSessionPartnerParametersFilename
+                                                 class:[NSDictionary class]
+                                                 objectName:@"Session Partner parameters"
+                                                 syncObject:[ALTSessionParameters class]];
 }
 
 # pragma mark - handlers status
@@ -2499,9 +2662,15 @@ sdkClickHandlerOnly:(BOOL)sdkClickHandlerOnly
         [selfI.packageHandler sendFirstPackage];
     }
 
+    // counters are stored in place on every tick, the full archive only goes to disk
+    // on transitions or once the safety interval has passed
     double now = [NSDate.date timeIntervalSince1970];
     if ([selfI updateActivityStateI:selfI now:now]) {
-        [selfI writeActivityStateI:selfI];
+        if (now - selfI.lastActivityStateWrite >= kActivityStateSafetyInterval) {
+            [selfI writeActivityStateI:selfI];
+        } else {
+            [selfI writeActivityCountersI:selfI];
+        }
     }
 
     [selfI.trackingStatusManager checkForNewAttStatus];
@@ -2785,8 +2954,23 @@ sdkClickHandlerOnly:(BOOL)sdkClickHandlerOnly
         [selfI.logger verbose:@"Found transaction ID in %@", selfI.activityState.transactionIds];
         return NO; // transaction ID found -> used already
     }
-    
+    // older than the last ten, check the index of the ones before
+    ALTTransactionIdMatch match = [selfI.transactionIdIndex matchTransactionId:transactionId];
+    if (match == ALTTransactionIdMatchExact) {
+        [selfI.logger info:@"Skipping duplicate transaction ID '%@'", transactionId];
+        [selfI.logger verbose:@"Found transaction ID in index of the last %lu",
+         (unsigned long)selfI.transactionIdIndex.capacity];
+        return NO;
+    }
+    if (match == ALTTransactionIdMatchFingerprint) {
+        // can't be told apart from a collision with an older id, a revenue event isn't dropped on that
+        [selfI.logger warn:@"Tracking transaction ID '%@', it may repeat one of the last %lu transaction IDs",
+         transactionId, (unsigned long)selfI.transactionIdIndex.capacity];
+    }
+
     [selfI.activityState addTransactionId:transactionId];
+    [selfI.transactionIdIndex addTransactionId:transactionId];
+    [selfI.transactionIdIndex write];
     [selfI.logger verbose:@"Added transaction ID %@", selfI.activityState.transactionIds];
     // activity state will get written by caller
     return YES;
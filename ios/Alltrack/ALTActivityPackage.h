@@ -14,6 +14,10 @@
 
 @property (nonatomic, strong) NSDictionary *callbackParameters;
 
+// Delivery
+
+@property (nonatomic, assign) NSInteger retries;
+
 // Logs
 
 @property (nonatomic, copy) NSString *suffix;
@@ -61,6 +61,8 @@
     self.parameters = [decoder decodeObjectForKey:@"parameters"];
     self.partnerParameters = [decoder decodeObjectForKey:@"partnerParameters"];
     self.callbackParameters = [decoder decodeObjectForKey:@"callbackParameters"];
+    // absent in packages archived before it was kept, which then start from zero
+    self.retries = [decoder decodeIntegerForKey:@"retries"];
 
     NSString *kindString = [decoder decodeObjectForKey:@"kind"];
     self.activityKind = [ALTActivityKindUtil activityKindFromString:kindString];
@@ -78,6 +80,7 @@
     [encoder encodeObject:self.parameters forKey:@"parameters"];
     [encoder encodeObject:self.callbackParameters forKey:@"callbackParameters"];
     [encoder encodeObject:self.partnerParameters forKey:@"partnerParameters"];
+    [encoder encodeInteger:self.retries forKey:@"retries"];
 }
 
 @end
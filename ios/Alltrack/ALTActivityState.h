@@ -29,6 +29,9 @@
 @property (nonatomic, assign) double lastActivity;      // Entire time in seconds since 1970
 @property (nonatomic, assign) double sessionLength;     // Entire duration in seconds
 
+// Generation of the counters record written last with this state
+@property (nonatomic, assign) uint64_t recordGeneration;
+
 // last ten transaction identifiers
 @property (nonatomic, strong) NSMutableArray *transactionIds;
 
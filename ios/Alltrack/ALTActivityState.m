@@ -112,6 +112,7 @@ static NSString *appToken = nil;
     self.sessionLength = [decoder decodeDoubleForKey:@"sessionLength"];
     self.timeSpent = [decoder decodeDoubleForKey:@"timeSpent"];
     self.lastActivity = [decoder decodeDoubleForKey:@"lastActivity"];
+    self.recordGeneration = (uint64_t)[decoder decodeInt64ForKey:@"recordGeneration"];
     
     // Default values for migrating devices.
     if ([decoder containsValueForKey:@"uuid"]) {
@@ -195,6 +196,7 @@ static NSString *appToken = nil;
     [encoder encodeDouble:self.sessionLength forKey:@"sessionLength"];
     [encoder encodeDouble:self.timeSpent forKey:@"timeSpent"];
     [encoder encodeDouble:self.lastActivity forKey:@"lastActivity"];
+    [encoder encodeInt64:(int64_t)self.recordGeneration forKey:@"recordGeneration"];
     [encoder encodeObject:self.dedupeToken forKey:@"uuid"];
     [encoder encodeObject:self.transactionIds forKey:@"transactionIds"];
     [encoder encodeBool:self.enabled forKey:@"enabled"];
@@ -0,0 +1,27 @@
+#import <Foundation/Foundation.h>
+
+#import "ALTActivityState.h"
+
+// Fixed layout record of the activity state counters, mapped into memory.
+// Counter updates are stored in place instead of archiving the whole activity state.
+// The record keeps two checksummed slots and writes into the older one, so an update
+// interrupted half way leaves the previous counters readable.
+@interface ALTActivityStateRecord : NSObject
+
+// nil when the file can't be created or mapped.
++ (ALTActivityStateRecord *)recordWithFileName:(NSString *)fileName;
+
+// Must be called while holding the activity state lock.
+// Stores the generation of the written slot in the activity state, for its next archive.
+- (void)writeCountersOfActivityState:(ALTActivityState *)activityState;
+
+// Overwrites the counters of the activity state with the latest valid slot, unless that slot
+// is of an older generation than the archived state. Returns NO when nothing was restored.
+- (BOOL)restoreCountersOfActivityState:(ALTActivityState *)activityState;
+
+// Schedules the mapped pages to be flushed, without waiting for it.
+- (void)flush;
+
+- (void)teardown;
+
+@end
@@ -0,0 +1,205 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#import "ALTActivityStateRecord.h"
+#import "ALTAlltrackFactory.h"
+#import "ALTUtil.h"
+
+static const uint32_t kRecordMagic = 0x414c5452; // "ALTR"
+static const uint32_t kRecordVersion = 1;
+static const NSUInteger kSlotCount = 2;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sequence;
+    int32_t eventCount;
+    int32_t sessionCount;
+    int32_t subsessionCount;
+    int32_t reserved;
+    double timeSpent;
+    double lastActivity;
+    double sessionLength;
+    // covers every field above, written last
+    uint64_t checksum;
+} ALTActivityStateSlot;
+
+_Static_assert(sizeof(ALTActivityStateSlot) == 64, "activity state slot layout changed");
+
+static const size_t kRecordSize = sizeof(ALTActivityStateSlot) * kSlotCount;
+
+static uint64_t slotChecksum(const ALTActivityStateSlot *slot) {
+    // FNV-1a
+    const uint8_t *bytes = (const uint8_t *)slot;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < offsetof(ALTActivityStateSlot, checksum); i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static BOOL isSlotValid(const ALTActivityStateSlot *slot) {
+    return slot->magic == kRecordMagic
+        && slot->version == kRecordVersion
+        && slot->checksum == slotChecksum(slot);
+}
+
+#pragma mark - private
+@interface ALTActivityStateRecord() {
+    ALTActivityStateSlot *_slots;
+    uint64_t _sequence;
+}
+
+@end
+
+#pragma mark -
+@implementation ALTActivityStateRecord
+
++ (ALTActivityStateRecord *)recordWithFileName:(NSString *)fileName {
+    NSString *filePath = [ALTUtil getFilePathInAppSupportDir:fileName];
+    if (filePath == nil) {
+        [[ALTAlltrackFactory logger] error:@"Cannot get filepath from filename: %@, to map activity state record", fileName];
+        return nil;
+    }
+    return [[ALTActivityStateRecord alloc] initWithFilePath:filePath];
+}
+
+- (id)initWithFilePath:(NSString *)filePath {
+    self = [super init];
+    if (self == nil) return nil;
+
+    int fd = open([filePath fileSystemRepresentation], O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        [[ALTAlltrackFactory logger] error:@"Failed to open activity state record (%d)", errno];
+        return nil;
+    }
+
+    struct stat fileStat;
+    BOOL created = NO;
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t)kRecordSize) {
+        // new or truncated file, zeroed slots are never valid
+        if (ftruncate(fd, (off_t)kRecordSize) != 0) {
+            [[ALTAlltrackFactory logger] error:@"Failed to size activity state record (%d)", errno];
+            close(fd);
+            return nil;
+        }
+        created = YES;
+    }
+
+    void *mapped = mmap(NULL, kRecordSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // the mapping keeps the file open
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        [[ALTAlltrackFactory logger] error:@"Failed to map activity state record (%d)", errno];
+        return nil;
+    }
+    _slots = (ALTActivityStateSlot *)mapped;
+
+    if (created) {
+        [ALTUtil excludeFromBackup:filePath];
+    }
+
+    const ALTActivityStateSlot *latest = [self latestValidSlot];
+    _sequence = latest != NULL ? latest->sequence : 0;
+
+    return self;
+}
+
+- (void)writeCountersOfActivityState:(ALTActivityState *)activityState {
+    if (_slots == NULL || activityState == nil) {
+        return;
+    }
+
+    // always overwrite the older slot, the latest one stays valid until this one is complete
+    uint64_t sequence = _sequence + 1;
+    ALTActivityStateSlot *slot = &_slots[sequence % kSlotCount];
+
+    slot->checksum = 0;
+    atomic_thread_fence(memory_order_release);
+
+    slot->magic = kRecordMagic;
+    slot->version = kRecordVersion;
+    slot->sequence = sequence;
+    slot->eventCount = activityState.eventCount;
+    slot->sessionCount = activityState.sessionCount;
+    slot->subsessionCount = activityState.subsessionCount;
+    slot->reserved = 0;
+    slot->timeSpent = activityState.timeSpent;
+    slot->lastActivity = activityState.lastActivity;
+    slot->sessionLength = activityState.sessionLength;
+    uint64_t checksum = slotChecksum(slot);
+    atomic_thread_fence(memory_order_release);
+
+    slot->checksum = checksum;
+    _sequence = sequence;
+    activityState.recordGeneration = sequence;
+}
+
+- (BOOL)restoreCountersOfActivityState:(ALTActivityState *)activityState {
+    if (_slots == NULL || activityState == nil) {
+        return NO;
+    }
+
+    // the slot sequence is the generation, the archive holds the one of the last slot written
+    // before it; counters can move back legitimately, so they can't tell which one is newer
+    const ALTActivityStateSlot *slot = [self latestValidSlot];
+    if (slot == NULL || slot->sequence < activityState.recordGeneration) {
+        // lost or left behind by an older run, later writes have to count on from the archive
+        if (_sequence < activityState.recordGeneration) {
+            _sequence = activityState.recordGeneration;
+        }
+        return NO;
+    }
+
+    activityState.eventCount = slot->eventCount;
+    activityState.sessionCount = slot->sessionCount;
+    activityState.subsessionCount = slot->subsessionCount;
+    activityState.timeSpent = slot->timeSpent;
+    activityState.lastActivity = slot->lastActivity;
+    activityState.sessionLength = slot->sessionLength;
+    return YES;
+}
+
+- (void)flush {
+    if (_slots == NULL) {
+        return;
+    }
+    msync(_slots, kRecordSize, MS_ASYNC);
+}
+
+- (void)teardown {
+    if (_slots == NULL) {
+        return;
+    }
+    msync(_slots, kRecordSize, MS_SYNC);
+    munmap(_slots, kRecordSize);
+    _slots = NULL;
+}
+
+- (void)dealloc {
+    [self teardown];
+}
+
+#pragma mark - private
+
+- (const ALTActivityStateSlot *)latestValidSlot {
+    const ALTActivityStateSlot *latest = NULL;
+    for (NSUInteger i = 0; i < kSlotCount; i++) {
+        const ALTActivityStateSlot *slot = &_slots[i];
+        if (!isSlotValid(slot)) {
+            continue;
+        }
+        if (latest == NULL || slot->sequence > latest->sequence) {
+            latest = slot;
+        }
+    }
+    return latest;
+}
+
+@end
@@ -0,0 +1,39 @@
+#import <Foundation/Foundation.h>
+
+// Source of AdServices attribution tokens. The default one asks the AdServices framework,
+// another one can be set on the cache, e.g. one answering with fixed tokens and delays.
+@protocol ALTAdServicesTokenProvider <NSObject>
+
+// Blocking, only ever called off the SDK queues.
+- (NSString *)attributionTokenWithError:(NSError **)errorPtr;
+
+@end
+
+@interface ALTAdServicesSystemTokenProvider : NSObject <ALTAdServicesTokenProvider>
+
+@end
+
+// Keeps the last AdServices token for a while, so the sdk_click queue can use it at send time
+// without waiting on the framework. Fetches run on a global queue, and concurrent requests for
+// a token share a single fetch. Expiry is measured on the clock of the shared timer wheel.
+@interface ALTAdServicesTokenCache : NSObject
+
+@property (nonatomic, strong) id<ALTAdServicesTokenProvider> provider;
+
++ (ALTAdServicesTokenCache *)sharedCache;
+
+- (id)initWithProvider:(id<ALTAdServicesTokenProvider>)provider
+            timeToLive:(NSTimeInterval)timeToLive;
+
+// The cached token, or nil if there is none or it expired. Never blocks.
+- (NSString *)cachedToken;
+
+// Fetches a token in the background unless a fresh one is cached or a fetch is running.
+- (void)prefetch;
+
+// Calls back on a global queue, with the cached token if it is fresh or else a fetched one.
+- (void)tokenWithCompletion:(void (^)(NSString *token, NSError *error))completion;
+
+- (void)clear;
+
+@end
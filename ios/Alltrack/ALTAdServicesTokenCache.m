@@ -0,0 +1,121 @@
+#import "ALTAdServicesTokenCache.h"
+#import "ALTTimerWheel.h"
+#import "ALTUtil.h"
+
+// tokens stay valid for 24 hours, one of up to an hour is still accepted for a click
+static const NSTimeInterval kDefaultTimeToLive = 60 * 60;
+
+static ALTAdServicesTokenCache *sharedCache = nil;
+
+#pragma mark - system provider
+@implementation ALTAdServicesSystemTokenProvider
+
+- (NSString *)attributionTokenWithError:(NSError **)errorPtr {
+    return [ALTUtil fetchAdServicesAttribution:errorPtr];
+}
+
+@end
+
+#pragma mark - private
+@interface ALTAdServicesTokenCache()
+
+@property (nonatomic, assign) NSTimeInterval timeToLive;
+@property (nonatomic, copy) NSString *token;
+@property (nonatomic, assign) NSTimeInterval expiresAt;
+// non-nil while a fetch is running
+@property (nonatomic, strong) NSMutableArray *pendingCompletions;
+
+@end
+
+#pragma mark -
+@implementation ALTAdServicesTokenCache
+
++ (ALTAdServicesTokenCache *)sharedCache {
+    @synchronized (self) {
+        if (sharedCache == nil) {
+            sharedCache = [[ALTAdServicesTokenCache alloc]
+                           initWithProvider:[[ALTAdServicesSystemTokenProvider alloc] init]
+                           timeToLive:kDefaultTimeToLive];
+        }
+        return sharedCache;
+    }
+}
+
+- (id)initWithProvider:(id<ALTAdServicesTokenProvider>)provider
+            timeToLive:(NSTimeInterval)timeToLive {
+    self = [super init];
+    if (self == nil) return nil;
+
+    self.provider = provider;
+    self.timeToLive = timeToLive;
+
+    return self;
+}
+
+- (NSString *)cachedToken {
+    @synchronized (self) {
+        if (self.token == nil || [[ALTTimerWheel sharedWheel] now] >= self.expiresAt) {
+            return nil;
+        }
+        return self.token;
+    }
+}
+
+- (void)prefetch {
+    [self tokenWithCompletion:nil];
+}
+
+- (void)tokenWithCompletion:(void (^)(NSString *token, NSError *error))completion {
+    NSString *cachedToken = [self cachedToken];
+    if (cachedToken != nil) {
+        if (completion != nil) {
+            dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+                completion(cachedToken, nil);
+            });
+        }
+        return;
+    }
+
+    id<ALTAdServicesTokenProvider> provider;
+    @synchronized (self) {
+        BOOL fetching = self.pendingCompletions != nil;
+        if (!fetching) {
+            self.pendingCompletions = [NSMutableArray array];
+        }
+        if (completion != nil) {
+            [self.pendingCompletions addObject:[completion copy]];
+        }
+        if (fetching) {
+            return;
+        }
+        provider = self.provider;
+    }
+
+    dispatch_async(dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+        NSError *error = nil;
+        NSString *token = [provider attributionTokenWithError:&error];
+
+        NSArray *completions;
+        @synchronized (self) {
+            // failures aren't cached, the next request tries again
+            if (token != nil && error == nil) {
+                self.token = token;
+                self.expiresAt = [[ALTTimerWheel sharedWheel] now] + self.timeToLive;
+            }
+            completions = self.pendingCompletions;
+            self.pendingCompletions = nil;
+        }
+        for (void (^pendingCompletion)(NSString *, NSError *) in completions) {
+            pendingCompletion(token, error);
+        }
+    });
+}
+
+- (void)clear {
+    @synchronized (self) {
+        self.token = nil;
+        self.expiresAt = 0;
+    }
+}
+
+@end
@@ -29,6 +29,56 @@
 }
 
 - (NSString *)altUrlEncode {
+    // everything outside of the unreserved characters gets escaped, as with the escape set below
+    static BOOL unreserved[256];
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        const char *characters = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~";
+        for (const char *c = characters; *c != '\0'; c++) {
+            unreserved[(uint8_t)*c] = YES;
+        }
+    });
+    static const char hexDigits[] = "0123456789ABCDEF";
+
+    // the UTF-8 buffer of the string itself when it has one, a converted copy otherwise
+    NSUInteger length = 0;
+    NSData *utf8Data = nil;
+    const uint8_t *bytes = (const uint8_t *)CFStringGetCStringPtr((CFStringRef)self, kCFStringEncodingUTF8);
+    if (bytes != NULL) {
+        length = [self lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+    } else {
+        utf8Data = [self dataUsingEncoding:NSUTF8StringEncoding allowLossyConversion:NO];
+        bytes = utf8Data.bytes;
+        length = utf8Data.length;
+    }
+    if (bytes == NULL && self.length > 0) {
+        // not representable as UTF-8, let CoreFoundation decide
+        return [self altUrlEncodeWithCoreFoundation];
+    }
+
+    // single pass over the bytes, no per-character lookups through CoreFoundation
+    char *escaped = malloc(length * 3 + 1);
+    if (escaped == NULL) {
+        return [self altUrlEncodeWithCoreFoundation];
+    }
+    char *output = escaped;
+    for (NSUInteger i = 0; i < length; i++) {
+        uint8_t byte = bytes[i];
+        if (unreserved[byte]) {
+            *output++ = (char)byte;
+        } else {
+            *output++ = '%';
+            *output++ = hexDigits[byte >> 4];
+            *output++ = hexDigits[byte & 0x0f];
+        }
+    }
+    return [[NSString alloc] initWithBytesNoCopy:escaped
+                                          length:(NSUInteger)(output - escaped)
+                                        encoding:NSASCIIStringEncoding
+                                    freeWhenDone:YES];
+}
+
+- (NSString *)altUrlEncodeWithCoreFoundation {
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdeprecated-declarations"
     return (NSString *)CFBridgingRelease(CFURLCreateStringByAddingPercentEscapes(
@@ -38,9 +88,6 @@
                                                                                  (CFStringRef)@"!*'\"();:@&=+$,/?%#[]% ",
                                                                                  CFStringConvertNSStringEncodingToEncoding(NSUTF8StringEncoding)));
 #pragma clang diagnostic pop
-    // Alternative:
-    // return [self stringByAddingPercentEncodingWithAllowedCharacters:
-    //        [NSCharacterSet characterSetWithCharactersInString:@"!*'\"();:@&=+$,/?%#[]% "]];
 }
 
 - (NSString *)altUrlDecode {
@@ -1,6 +1,7 @@
 #import "ALTAlltrackFactory.h"
 #import "ALTActivityHandler.h"
 #import "ALTPackageHandler.h"
+#import "ALTSdkClickHandler.h"
 
 static id<ALTLogger> internalLogger = nil;
 
@@ -224,6 +225,7 @@ static NSString * internalSubscriptionUrl = nil;
     if (deleteState) {
         [ALTActivityHandler deleteState];
         [ALTPackageHandler deleteState];
+        [ALTSdkClickHandler deleteState];
     }
     internalLogger = nil;
 
@@ -1,10 +1,12 @@
 #import "ALTAttributionHandler.h"
 #import "ALTAlltrackFactory.h"
 #import "ALTUtil.h"
+#import "ALTExecutor.h"
 #import "ALTActivityHandler.h"
 #import "NSString+ALTAdditions.h"
 #import "ALTTimerOnce.h"
 #import "ALTPackageBuilder.h"
+#import "ALTBackoffStrategy.h"
 #import "ALTUtil.h"
 
 static const char * const kInternalQueueName     = "com.alltrack.AttributionQueue";
@@ -19,6 +21,12 @@ static NSString   * const kAttributionTimerName   = @"Attribution timer";
 @property (nonatomic, strong) ALTTimerOnce *attributionTimer;
 @property (atomic, assign) BOOL paused;
 @property (nonatomic, copy) NSString *lastInitiatedBy;
+// asks while a request is out are answered by its response instead of one request each
+@property (nonatomic, assign) BOOL requestInFlight;
+@property (nonatomic, assign) BOOL requestPending;
+// failed requests in a row that others were waiting on, they are asked again with a backoff
+@property (nonatomic, assign) NSInteger failedRequests;
+@property (nonatomic, strong) ALTBackoffStrategy *backoffStrategy;
 
 @end
 
@@ -31,15 +39,21 @@ static NSString   * const kAttributionTimerName   = @"Attribution timer";
     self = [super init];
     if (self == nil) return nil;
 
-    self.internalQueue = dispatch_queue_create(kInternalQueueName, DISPATCH_QUEUE_SERIAL);
+    self.internalQueue = [ALTExecutor mailboxWithName:kInternalQueueName
+                                             priority:ALTExecutorPriorityDefault];
     self.requestHandler = [[ALTRequestHandler alloc]
                                 initWithResponseCallback:self
                                 urlStrategy:urlStrategy
                                 userAgent:userAgent
-                                requestTimeout:[ALTAlltrackFactory requestTimeout]];
+                                requestTimeout:[ALTAlltrackFactory requestTimeout]
+                                callbackQueue:self.internalQueue];
+    // an unchanged attribution comes back as a 304 instead of the whole response
+    self.requestHandler.revalidatesGetResponses = YES;
     self.activityHandler = activityHandler;
     self.logger = ALTAlltrackFactory.logger;
     self.paused = !startsSending;
+    self.failedRequests = 0;
+    self.backoffStrategy = [ALTBackoffStrategy backoffStrategyWithType:ALTShortWait];
     __weak __typeof__(self) weakSelf = self;
     self.attributionTimer = [ALTTimerOnce timerWithBlock:^{
         __typeof__(self) strongSelf = weakSelf;
@@ -54,31 +68,23 @@ static NSString   * const kAttributionTimerName   = @"Attribution timer";
 }
 
 - (void)checkSessionResponse:(ALTSessionResponseData *)sessionResponseData {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTAttributionHandler* selfI) {
-                         [selfI checkSessionResponseI:selfI
-                                  sessionResponseData:sessionResponseData];
-                     }];
+    // always handled on the caller's queue, so responses keep their order whether or not they
+    // have ask_in; only scheduling the attribution request hops to the internal queue
+    [self checkSessionResponseI:self sessionResponseData:sessionResponseData];
 }
 
 - (void)checkSdkClickResponse:(ALTSdkClickResponseData *)sdkClickResponseData {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTAttributionHandler* selfI) {
-                         [selfI checkSdkClickResponseI:selfI
-                                  sdkClickResponseData:sdkClickResponseData];
-                     }];
+    [self checkSdkClickResponseI:self sdkClickResponseData:sdkClickResponseData];
 }
 
 - (void)checkAttributionResponse:(ALTAttributionResponseData *)attributionResponseData {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTAttributionHandler* selfI) {
-                         [selfI checkAttributionResponseI:selfI
-                                  attributionResponseData:attributionResponseData];
+    [ALTUtil launchInOwnQueue:self.internalQueue
+                   selfInject:self
+                        block:^(ALTAttributionHandler* selfI) {
+                            [selfI checkAttributionResponseI:selfI
+                                     attributionResponseData:attributionResponseData];
 
-                     }];
+                        }];
 }
 
 - (void)getAttribution {
@@ -92,6 +98,17 @@ static NSString   * const kAttributionTimerName   = @"Attribution timer";
                      }];
 }
 
+- (void)askAttributionForBackend:(int)milliSecondsDelay {
+    // inline for attribution responses, so it is set before their response callback goes on
+    [ALTUtil launchInOwnQueue:self.internalQueue
+                   selfInject:self
+                        block:^(ALTAttributionHandler* selfI) {
+                            selfI.lastInitiatedBy = @"backend";
+                            [selfI waitRequestAttributionWithDelayI:selfI
+                                                  milliSecondsDelay:milliSecondsDelay];
+                        }];
+}
+
 - (void)pauseSending {
     self.paused = YES;
 }
@@ -126,6 +143,7 @@ static NSString   * const kAttributionTimerName   = @"Attribution timer";
 
 - (void)checkAttributionI:(ALTAttributionHandler*)selfI
              responseData:(ALTResponseData *)responseData {
+    [responseData markStage:ALTResponseStageAttribution];
     if (responseData.jsonResponse == nil) {
         return;
     }
@@ -135,22 +153,26 @@ static NSString   * const kAttributionTimerName   = @"Attribution timer";
     if (timerMilliseconds != nil) {
         [selfI.activityHandler setAskingAttribution:YES];
 
-        selfI.lastInitiatedBy = @"backend";
-        [selfI waitRequestAttributionWithDelayI:selfI
-                              milliSecondsDelay:[timerMilliseconds intValue]];
+        [selfI askAttributionForBackend:[timerMilliseconds intValue]];
 
         return;
     }
 
     [selfI.activityHandler setAskingAttribution:NO];
 
+    if (responseData.notModified) {
+        // same attribution as last time, nothing to parse or deliver again
+        [selfI.logger verbose:@"Attribution not modified"];
+        return;
+    }
+
     NSDictionary * jsonAttribution = [responseData.jsonResponse objectForKey:@"attribution"];
     responseData.attribution = [ALTAttribution dataWithJsonDict:jsonAttribution adid:responseData.adid];
 }
 
 - (void)checkDeeplinkI:(ALTAttributionHandler*)selfI
 attributionResponseData:(ALTAttributionResponseData *)attributionResponseData {
-    if (attributionResponseData.jsonResponse == nil) {
+    if (attributionResponseData.jsonResponse == nil || attributionResponseData.notModified) {
         return;
     }
 
@@ -176,6 +198,12 @@ attributionResponseData:(ALTAttributionResponseData *)attributionResponseData {
         [selfI.logger debug:@"Attribution request won't be fired for forgotten user"];
         return;
     }
+    if (selfI.requestInFlight) {
+        [selfI.logger debug:@"Attribution request already in flight, waiting for its response"];
+        selfI.requestPending = YES;
+        return;
+    }
+    selfI.requestInFlight = YES;
 
     ALTActivityPackage* attributionPackage = [selfI buildAndGetAttributionPackageI:selfI];
 
@@ -190,6 +218,11 @@ attributionResponseData:(ALTAttributionResponseData *)attributionResponseData {
 }
 
 - (void)responseCallback:(ALTResponseData *)responseData {
+    [responseData markStage:ALTResponseStageHandler];
+    // called on the internal queue
+    BOOL askedMeanwhile = self.requestPending;
+    self.requestInFlight = NO;
+    self.requestPending = NO;
     if (responseData.jsonResponse) {
         [self.logger debug:
             @"Got attribution JSON response with message: %@", responseData.message];
@@ -208,11 +241,32 @@ attributionResponseData:(ALTAttributionResponseData *)attributionResponseData {
     if ([responseData isKindOfClass:[ALTAttributionResponseData class]]) {
         [self checkAttributionResponse:(ALTAttributionResponseData*)responseData];
     }
+    if (responseData.jsonResponse != nil) {
+        self.failedRequests = 0;
+    }
+
+    if (!askedMeanwhile) {
+        return;
+    }
+    if (responseData.jsonResponse == nil) {
+        // the request the others waited on failed, ask once more for all of them after a backoff
+        self.failedRequests++;
+        NSTimeInterval waitTime = [ALTUtil waitingTime:self.failedRequests backoffStrategy:self.backoffStrategy];
+        [self.logger verbose:@"Waiting for %@ seconds before asking for attribution again",
+         [ALTUtil secondsNumberFormat:waitTime]];
+        [self waitRequestAttributionWithDelayI:self milliSecondsDelay:(int)(waitTime * 1000)];
+        return;
+    }
+    // answered by this response, unless it scheduled the next ask for the backend
+    if ([responseData.jsonResponse objectForKey:@"ask_in"] == nil) {
+        self.lastInitiatedBy = nil;
+    }
 }
 
 - (void)waitRequestAttributionWithDelayI:(ALTAttributionHandler*)selfI
                        milliSecondsDelay:(int)milliSecondsDelay {
-    NSTimeInterval secondsDelay = milliSecondsDelay / 1000;
+    // not rounded down to whole seconds, backoff waits start well below one
+    NSTimeInterval secondsDelay = milliSecondsDelay / 1000.0;
     NSTimeInterval nextAskIn = [selfI.attributionTimer fireIn];
     if (nextAskIn > secondsDelay) {
         return;
@@ -257,6 +311,7 @@ attributionResponseData:(ALTAttributionResponseData *)attributionResponseData {
     self.logger = nil;
     self.attributionTimer = nil;
     self.requestHandler = nil;
+    self.backoffStrategy = nil;
 }
 
 @end
@@ -0,0 +1,35 @@
+#import <Foundation/Foundation.h>
+
+typedef struct {
+    NSUInteger depth;
+    NSUInteger maxDepth;
+    NSUInteger overflows;
+    NSTimeInterval maxWait;
+} ALTCommandQueueStats;
+
+// Bounded multi-producer single-consumer ring.
+// Any thread may enqueue, only the owner of the consumer side may dequeue.
+// Commands that find the ring full wait in an overflow list, which is only taken once the
+// ring is empty again, so they keep their place in the order.
+@interface ALTCommandQueue : NSObject
+
++ (ALTCommandQueue *)queueWithCapacity:(NSUInteger)capacity;
+
+- (id)initWithCapacity:(NSUInteger)capacity;
+
+// Always takes the command. Returns YES when no drain is scheduled, the caller then has to
+// schedule one; a drain that is scheduled or running already picks the command up.
+- (BOOL)enqueue:(id)command;
+
+// Consumer side only.
+- (id)dequeue;
+// Stops when the ring is empty or at a slot a producer claimed but hasn't filled yet, that
+// producer then schedules the next drain. Returns YES when the limit was reached with
+// commands left, the caller still owns the drain and has to schedule it again.
+- (BOOL)drainWithLimit:(NSUInteger)limit block:(void (^)(id command))block;
+
+- (NSUInteger)capacity;
+- (ALTCommandQueueStats)stats;
+- (void)teardown;
+
+@end
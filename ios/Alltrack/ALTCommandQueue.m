@@ -0,0 +1,296 @@
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+#include <pthread.h>
+
+#import "ALTCommandQueue.h"
+
+typedef struct {
+    atomic_uintptr_t sequence;
+    void *command;
+    uint64_t enqueuedAt;
+} ALTCommandCell;
+
+static const NSUInteger kMinCapacity = 2;
+
+#pragma mark - private
+@interface ALTCommandQueue() {
+    ALTCommandCell *_cells;
+    NSUInteger _mask;
+    atomic_uintptr_t _enqueuePosition;
+    atomic_uintptr_t _dequeuePosition;
+    atomic_uintptr_t _overflows;
+    atomic_uintptr_t _maxDepth;
+    atomic_uint_fast64_t _maxWaitTicks;
+    atomic_bool _drainScheduled;
+    atomic_bool _overflowing;
+    pthread_mutex_t _overflowLock;
+    NSMutableArray *_overflow;
+    // overflow commands the consumer took, handled before anything in the ring
+    NSMutableArray *_takenOverflow;
+}
+
+@end
+
+#pragma mark -
+@implementation ALTCommandQueue
+
++ (ALTCommandQueue *)queueWithCapacity:(NSUInteger)capacity {
+    return [[ALTCommandQueue alloc] initWithCapacity:capacity];
+}
+
+- (id)initWithCapacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self == nil) return nil;
+
+    // round up to a power of two so that positions can be masked into the ring
+    NSUInteger size = kMinCapacity;
+    while (size < capacity) {
+        size <<= 1;
+    }
+    _mask = size - 1;
+    _cells = calloc(size, sizeof(ALTCommandCell));
+    if (_cells == NULL) {
+        return nil;
+    }
+    for (NSUInteger i = 0; i < size; i++) {
+        atomic_init(&_cells[i].sequence, i);
+    }
+
+    atomic_init(&_enqueuePosition, 0);
+    atomic_init(&_dequeuePosition, 0);
+    atomic_init(&_overflows, 0);
+    atomic_init(&_maxDepth, 0);
+    atomic_init(&_maxWaitTicks, 0);
+    atomic_init(&_drainScheduled, false);
+    atomic_init(&_overflowing, false);
+    pthread_mutex_init(&_overflowLock, NULL);
+    _overflow = [NSMutableArray array];
+    _takenOverflow = [NSMutableArray array];
+
+    return self;
+}
+
+- (BOOL)enqueue:(id)command {
+    if (command == nil) {
+        return NO;
+    }
+
+    // once a command waits in the overflow list, the ones after it have to wait there too
+    if (!atomic_load_explicit(&_overflowing, memory_order_acquire)
+        || ![self addToOverflow:command onlyIfOverflowing:YES])
+    {
+        if (![self push:command]) {
+            [self addToOverflow:command onlyIfOverflowing:NO];
+        }
+    }
+
+    // pairs with the fence in drainWithLimit:block:, either the drain sees the command
+    // or this call sees that no drain is scheduled
+    atomic_thread_fence(memory_order_seq_cst);
+    return !atomic_exchange_explicit(&_drainScheduled, true, memory_order_acq_rel);
+}
+
+- (id)dequeue {
+    if (_takenOverflow.count > 0) {
+        id command = _takenOverflow[0];
+        [_takenOverflow removeObjectAtIndex:0];
+        return command;
+    }
+
+    id command = [self pop];
+    if (command != nil) {
+        return command;
+    }
+
+    // overflow commands were enqueued after everything in the ring
+    if (![self isRingEmpty] || !atomic_load_explicit(&_overflowing, memory_order_acquire)) {
+        return nil;
+    }
+    pthread_mutex_lock(&_overflowLock);
+    NSMutableArray *overflow = _overflow;
+    _overflow = _takenOverflow;
+    _takenOverflow = overflow;
+    atomic_store_explicit(&_overflowing, false, memory_order_release);
+    pthread_mutex_unlock(&_overflowLock);
+
+    if (_takenOverflow.count == 0) {
+        return nil;
+    }
+    command = _takenOverflow[0];
+    [_takenOverflow removeObjectAtIndex:0];
+    return command;
+}
+
+- (BOOL)drainWithLimit:(NSUInteger)limit block:(void (^)(id command))block {
+    NSUInteger drained = 0;
+    for (;;) {
+        while (drained < limit) {
+            id command = [self dequeue];
+            if (command == nil) {
+                break;
+            }
+            drained++;
+            block(command);
+        }
+        if (drained == limit && [self hasCommand]) {
+            return YES;
+        }
+
+        atomic_store_explicit(&_drainScheduled, false, memory_order_release);
+        atomic_thread_fence(memory_order_seq_cst);
+        // a producer that enqueued before the store above but wasn't seen yet found the drain
+        // still scheduled, so this drain has to go on; one that enqueues after it schedules
+        // the next drain itself
+        if (![self hasCommand]
+            || atomic_exchange_explicit(&_drainScheduled, true, memory_order_acq_rel))
+        {
+            return NO;
+        }
+        if (drained == limit) {
+            return YES;
+        }
+    }
+}
+
+- (NSUInteger)capacity {
+    return _mask + 1;
+}
+
+- (ALTCommandQueueStats)stats {
+    static mach_timebase_info_data_t timebase;
+    if (timebase.denom == 0) {
+        mach_timebase_info(&timebase);
+    }
+
+    uintptr_t enqueuePosition = atomic_load_explicit(&_enqueuePosition, memory_order_relaxed);
+    uintptr_t dequeuePosition = atomic_load_explicit(&_dequeuePosition, memory_order_relaxed);
+    uint64_t maxWaitTicks = atomic_load_explicit(&_maxWaitTicks, memory_order_relaxed);
+
+    ALTCommandQueueStats stats;
+    stats.depth = enqueuePosition - dequeuePosition;
+    stats.maxDepth = atomic_load_explicit(&_maxDepth, memory_order_relaxed);
+    stats.overflows = atomic_load_explicit(&_overflows, memory_order_relaxed);
+    stats.maxWait = (double)maxWaitTicks * timebase.numer / timebase.denom / NSEC_PER_SEC;
+    return stats;
+}
+
+- (void)teardown {
+    while ([self pop] != nil) {
+        // releases whatever is still in the ring
+    }
+    pthread_mutex_lock(&_overflowLock);
+    [_overflow removeAllObjects];
+    [_takenOverflow removeAllObjects];
+    pthread_mutex_unlock(&_overflowLock);
+}
+
+- (void)dealloc {
+    [self teardown];
+    pthread_mutex_destroy(&_overflowLock);
+    free(_cells);
+}
+
+#pragma mark - private
+
+- (BOOL)push:(id)command {
+    ALTCommandCell *cell;
+    uintptr_t position = atomic_load_explicit(&_enqueuePosition, memory_order_relaxed);
+    for (;;) {
+        cell = &_cells[position & _mask];
+        uintptr_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+        intptr_t difference = (intptr_t)sequence - (intptr_t)position;
+        if (difference == 0) {
+            if (atomic_compare_exchange_weak_explicit(&_enqueuePosition,
+                                                      &position,
+                                                      position + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            // consumer has not released this slot yet, ring is full
+            return NO;
+        } else {
+            position = atomic_load_explicit(&_enqueuePosition, memory_order_relaxed);
+        }
+    }
+
+    cell->command = (__bridge_retained void *)command;
+    cell->enqueuedAt = mach_absolute_time();
+    atomic_store_explicit(&cell->sequence, position + 1, memory_order_release);
+
+    [self updateMaxDepth:position + 1 - atomic_load_explicit(&_dequeuePosition, memory_order_relaxed)];
+
+    return YES;
+}
+
+- (id)pop {
+    uintptr_t position = atomic_load_explicit(&_dequeuePosition, memory_order_relaxed);
+    ALTCommandCell *cell = &_cells[position & _mask];
+    uintptr_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    if ((intptr_t)sequence - (intptr_t)(position + 1) < 0) {
+        // empty, or producer still writing into the slot
+        return nil;
+    }
+
+    id command = (__bridge_transfer id)cell->command;
+    uint64_t enqueuedAt = cell->enqueuedAt;
+    cell->command = NULL;
+    atomic_store_explicit(&cell->sequence, position + _mask + 1, memory_order_release);
+    atomic_store_explicit(&_dequeuePosition, position + 1, memory_order_relaxed);
+
+    uint64_t waitTicks = mach_absolute_time() - enqueuedAt;
+    if (waitTicks > atomic_load_explicit(&_maxWaitTicks, memory_order_relaxed)) {
+        atomic_store_explicit(&_maxWaitTicks, waitTicks, memory_order_relaxed);
+    }
+
+    return command;
+}
+
+- (BOOL)addToOverflow:(id)command onlyIfOverflowing:(BOOL)onlyIfOverflowing {
+    pthread_mutex_lock(&_overflowLock);
+    if (onlyIfOverflowing && !atomic_load_explicit(&_overflowing, memory_order_relaxed)) {
+        // the consumer took the overflow in the meantime, the ring is free again
+        pthread_mutex_unlock(&_overflowLock);
+        return NO;
+    }
+    [_overflow addObject:command];
+    atomic_store_explicit(&_overflowing, true, memory_order_release);
+    pthread_mutex_unlock(&_overflowLock);
+    atomic_fetch_add_explicit(&_overflows, 1, memory_order_relaxed);
+    return YES;
+}
+
+- (BOOL)isRingEmpty {
+    return atomic_load_explicit(&_enqueuePosition, memory_order_relaxed)
+        == atomic_load_explicit(&_dequeuePosition, memory_order_relaxed);
+}
+
+// Consumer side, whether a dequeue would return a command right now.
+- (BOOL)hasCommand {
+    if (_takenOverflow.count > 0) {
+        return YES;
+    }
+    uintptr_t position = atomic_load_explicit(&_dequeuePosition, memory_order_relaxed);
+    ALTCommandCell *cell = &_cells[position & _mask];
+    uintptr_t sequence = atomic_load_explicit(&cell->sequence, memory_order_acquire);
+    if ((intptr_t)sequence - (intptr_t)(position + 1) >= 0) {
+        return YES;
+    }
+    return [self isRingEmpty] && atomic_load_explicit(&_overflowing, memory_order_acquire);
+}
+
+- (void)updateMaxDepth:(uintptr_t)depth {
+    uintptr_t current = atomic_load_explicit(&_maxDepth, memory_order_relaxed);
+    while (depth > current) {
+        if (atomic_compare_exchange_weak_explicit(&_maxDepth,
+                                                  &current,
+                                                  depth,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+            break;
+        }
+    }
+}
+
+@end
@@ -175,6 +175,12 @@
  */
 @property (nonatomic, assign) double delayStart;
 
+/**
+ * @brief Number of transaction IDs remembered to skip duplicate events.
+ *        Defaults to 1000 when not set.
+ */
+@property (nonatomic, assign) NSUInteger transactionIdDedupCapacity;
+
 /**
  * @brief User agent for the requests.
  */
@@ -224,6 +230,12 @@
  */
 @property (nonatomic, assign) BOOL linkMeEnabled;
 
+/**
+ * @brief Compresses large request bodies with gzip.
+ *        Only enable it when the endpoint accepts gzip encoded bodies.
+ */
+@property (nonatomic, assign) BOOL requestBodyCompressionEnabled;
+
 /**
  * @brief Get configuration object for the initialization of the Alltrack SDK.
  *
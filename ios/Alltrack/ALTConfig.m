@@ -64,6 +64,7 @@
     self.allowiAdInfoReading = YES;
     self.allowAdServicesInfoReading = YES;
     self.linkMeEnabled = NO;
+    self.requestBodyCompressionEnabled = NO;
     _isSKAdNetworkHandlingActive = YES;
 
     return self;
@@ -197,6 +198,7 @@
         copy.allowiAdInfoReading = self.allowiAdInfoReading;
         copy.allowAdServicesInfoReading = self.allowAdServicesInfoReading;
         copy.delayStart = self.delayStart;
+        copy.transactionIdDedupCapacity = self.transactionIdDedupCapacity;
         copy.coppaCompliantEnabled = self.coppaCompliantEnabled;
         copy.userAgent = [self.userAgent copyWithZone:zone];
         copy.externalDeviceId = [self.externalDeviceId copyWithZone:zone];
@@ -207,6 +209,7 @@
         copy->_isSKAdNetworkHandlingActive = self.isSKAdNetworkHandlingActive;
         copy->_urlStrategy = [self.urlStrategy copyWithZone:zone];
         copy.linkMeEnabled = self.linkMeEnabled;
+        copy.requestBodyCompressionEnabled = self.requestBodyCompressionEnabled;
         // alltrack delegate not copied
     }
 
@@ -0,0 +1,40 @@
+#import <Foundation/Foundation.h>
+
+typedef NS_ENUM(NSInteger, ALTExecutorPriority) {
+    // work triggered by public API calls and lifecycle changes
+    ALTExecutorPriorityHigh = 0,
+    // network responses and callbacks
+    ALTExecutorPriorityDefault = 1,
+    // sending and retrying packages
+    ALTExecutorPriorityLow = 2
+};
+
+// Shared executor for the SDK handlers.
+// Each handler owns a serial mailbox. All mailboxes of the same priority target one
+// shared root, so the handlers run on a single pool of workers instead of four
+// independent queues.
+@interface ALTExecutor : NSObject
+
++ (dispatch_queue_t)mailboxWithName:(const char *)name
+                           priority:(ALTExecutorPriority)priority;
+
+// YES when called from a block running on the given mailbox.
++ (BOOL)isRunningOnMailbox:(dispatch_queue_t)mailbox;
+
++ (uint64_t)timestamp;
+
++ (NSTimeInterval)secondsSinceTimestamp:(uint64_t)timestamp;
+
++ (NSTimeInterval)secondsFromTimestamp:(uint64_t)fromTimestamp
+                           toTimestamp:(uint64_t)toTimestamp;
+
+// Called by the block once it starts running on its mailbox.
++ (void)recordSchedulingLatencySince:(uint64_t)timestamp;
+
+// Mailbox name to bucket counts. Bucket i counts blocks that waited less than 2^i microseconds,
+// the last bucket counts everything slower.
++ (NSDictionary<NSString *, NSArray<NSNumber *> *> *)schedulingLatencyHistograms;
+
++ (void)teardown;
+
+@end
@@ -0,0 +1,164 @@
+#include <stdatomic.h>
+#include <mach/mach_time.h>
+
+#import "ALTExecutor.h"
+
+static const NSUInteger kLatencyBucketCount = 20;
+static const char * const kRootQueueNames[] = {
+    "io.alltrack.Executor.high",
+    "io.alltrack.Executor.default",
+    "io.alltrack.Executor.low"
+};
+
+static char kMailboxKey;
+static dispatch_queue_t rootQueues[3];
+static NSMapTable<NSString *, id> *mailboxes = nil;
+static mach_timebase_info_data_t timebase;
+
+#pragma mark - mailbox statistics
+@interface ALTMailboxStats : NSObject {
+@public
+    atomic_uint_fast64_t buckets[kLatencyBucketCount];
+}
+
+@property (nonatomic, copy) NSString *name;
+
+@end
+
+@implementation ALTMailboxStats
+
+- (id)initWithName:(NSString *)name {
+    self = [super init];
+    if (self == nil) return nil;
+
+    self.name = name;
+    for (NSUInteger i = 0; i < kLatencyBucketCount; i++) {
+        atomic_init(&buckets[i], 0);
+    }
+
+    return self;
+}
+
+- (void)record:(uint64_t)nanoseconds {
+    uint64_t microseconds = nanoseconds / NSEC_PER_USEC;
+    NSUInteger bucket = 0;
+    while (bucket < kLatencyBucketCount - 1 && microseconds >= (1ULL << bucket)) {
+        bucket++;
+    }
+    atomic_fetch_add_explicit(&buckets[bucket], 1, memory_order_relaxed);
+}
+
+- (NSArray<NSNumber *> *)counts {
+    NSMutableArray<NSNumber *> *counts = [NSMutableArray arrayWithCapacity:kLatencyBucketCount];
+    for (NSUInteger i = 0; i < kLatencyBucketCount; i++) {
+        [counts addObject:@(atomic_load_explicit(&buckets[i], memory_order_relaxed))];
+    }
+    return counts;
+}
+
+@end
+
+static void releaseMailboxStats(void *context) {
+    CFBridgingRelease(context);
+}
+
+#pragma mark -
+@implementation ALTExecutor
+
++ (void)initialize {
+    if (self != [ALTExecutor class]) {
+        return;
+    }
+
+    mach_timebase_info(&timebase);
+
+    dispatch_qos_class_t qosClasses[] = { QOS_CLASS_USER_INITIATED, QOS_CLASS_DEFAULT, QOS_CLASS_UTILITY };
+    for (NSUInteger i = 0; i < 3; i++) {
+        dispatch_queue_attr_t attributes =
+            dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_CONCURRENT, qosClasses[i], 0);
+        rootQueues[i] = dispatch_queue_create(kRootQueueNames[i], attributes);
+    }
+
+    mailboxes = [NSMapTable strongToWeakObjectsMapTable];
+}
+
++ (dispatch_queue_t)mailboxWithName:(const char *)name
+                           priority:(ALTExecutorPriority)priority {
+    if (priority < ALTExecutorPriorityHigh || priority > ALTExecutorPriorityLow) {
+        priority = ALTExecutorPriorityDefault;
+    }
+
+    dispatch_queue_t mailbox = dispatch_queue_create(name, DISPATCH_QUEUE_SERIAL);
+    dispatch_set_target_queue(mailbox, rootQueues[priority]);
+
+    NSString *mailboxName = [NSString stringWithUTF8String:name];
+    ALTMailboxStats *stats = [[ALTMailboxStats alloc] initWithName:mailboxName];
+    dispatch_queue_set_specific(mailbox,
+                                &kMailboxKey,
+                                (void *)CFBridgingRetain(stats),
+                                releaseMailboxStats);
+    @synchronized (mailboxes) {
+        [mailboxes setObject:stats forKey:mailboxName];
+    }
+
+    return mailbox;
+}
+
++ (BOOL)isRunningOnMailbox:(dispatch_queue_t)mailbox {
+    if (mailbox == nil) {
+        return NO;
+    }
+    void *current = dispatch_get_specific(&kMailboxKey);
+    return current != NULL && current == dispatch_queue_get_specific(mailbox, &kMailboxKey);
+}
+
++ (uint64_t)timestamp {
+    return mach_absolute_time();
+}
+
++ (NSTimeInterval)secondsSinceTimestamp:(uint64_t)timestamp {
+    return [self secondsFromTimestamp:timestamp toTimestamp:mach_absolute_time()];
+}
+
++ (NSTimeInterval)secondsFromTimestamp:(uint64_t)fromTimestamp
+                           toTimestamp:(uint64_t)toTimestamp {
+    return (double)[self nanosecondsFrom:fromTimestamp to:toTimestamp] / NSEC_PER_SEC;
+}
+
++ (void)recordSchedulingLatencySince:(uint64_t)timestamp {
+    ALTMailboxStats *stats = (__bridge ALTMailboxStats *)dispatch_get_specific(&kMailboxKey);
+    if (stats == nil) {
+        return;
+    }
+    [stats record:[self nanosecondsFrom:timestamp to:mach_absolute_time()]];
+}
+
++ (NSDictionary<NSString *, NSArray<NSNumber *> *> *)schedulingLatencyHistograms {
+    NSMutableDictionary<NSString *, NSArray<NSNumber *> *> *histograms = [NSMutableDictionary dictionary];
+    @synchronized (mailboxes) {
+        for (NSString *name in mailboxes) {
+            ALTMailboxStats *stats = [mailboxes objectForKey:name];
+            if (stats != nil) {
+                [histograms setObject:[stats counts] forKey:name];
+            }
+        }
+    }
+    return histograms;
+}
+
++ (void)teardown {
+    @synchronized (mailboxes) {
+        [mailboxes removeAllObjects];
+    }
+}
+
+#pragma mark - private
+
++ (uint64_t)nanosecondsFrom:(uint64_t)fromTimestamp to:(uint64_t)toTimestamp {
+    if (toTimestamp <= fromTimestamp) {
+        return 0;
+    }
+    return (toTimestamp - fromTimestamp) * timebase.numer / timebase.denom;
+}
+
+@end
@@ -0,0 +1,28 @@
+#import <Foundation/Foundation.h>
+
+// Hand-built matchers for the fixed link patterns, replacing the regular expressions that were
+// compiled at launch. Each one is a single forward scan over the string, ASCII case-insensitive,
+// without allocating. Line breaks end a match the way "." does in the patterns, although the
+// absolute string of an NSURL never contains any.
+@interface ALTLinkMatcher : NSObject
+
+// https://[^.]*\.ulink\.alltrack\.com/ulink/?(.*)
+// Returns the range of the captured tail, location NSNotFound if it doesn't match.
++ (NSRange)universalLinkTailRangeInString:(NSString *)string;
+
+// http[s]?://[a-z0-9]{4}\.(?:[a-z]{2}\.)?alt\.st/?(.*)
+// Returns the range of the captured tail, location NSNotFound if it doesn't match.
++ (NSRange)shortUniversalLinkTailRangeInString:(NSString *)string;
+
+// alltrack_redirect=[^&#]*
+// Returns the number of matches, stopping at two, with the range of the first one.
++ (NSUInteger)optionalRedirectMatchesInString:(NSString *)string firstRange:(NSRange *)firstRange;
+
+// ^(fb|vk)[0-9]{5,}[^:]*://authorize.*access_token=.*
++ (BOOL)isExcludedDeeplink:(NSString *)string;
+
+// The "&" separated pairs of the query with a single "=", a non-empty value and a key starting
+// with the prefix, compared undecoded. All other pairs are skipped without being copied.
++ (NSArray<NSString *> *)pairsWithKeyPrefix:(NSString *)prefix inQuery:(NSString *)query;
+
+@end
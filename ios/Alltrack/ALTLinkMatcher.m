@@ -0,0 +1,256 @@
+#include <string.h>
+
+#import "ALTLinkMatcher.h"
+
+static const char * const kHttpsPrefix         = "https://";
+static const char * const kUniversalLinkHost   = ".ulink.alltrack.com/ulink";
+static const char * const kHttpPrefix          = "http";
+static const char * const kSchemeDelimiter     = "://";
+static const char * const kShortLinkDomain     = "alt.st";
+static const char * const kOptionalRedirect    = "alltrack_redirect=";
+static const char * const kAuthorizeHost       = "://authorize";
+static const char * const kAccessTokenParam    = "access_token=";
+static const NSUInteger kShortLinkIdLength     = 4;
+static const NSUInteger kMinExcludedAppIdDigits = 5;
+
+static inline UniChar characterAt(CFStringInlineBuffer *buffer, CFIndex index) {
+    return CFStringGetCharacterFromInlineBuffer(buffer, index);
+}
+
+static inline UniChar lowercaseAscii(UniChar character) {
+    return (character >= 'A' && character <= 'Z') ? (UniChar)(character + ('a' - 'A')) : character;
+}
+
+static inline BOOL isAsciiLetter(UniChar character) {
+    character = lowercaseAscii(character);
+    return character >= 'a' && character <= 'z';
+}
+
+static inline BOOL isAsciiDigit(UniChar character) {
+    return character >= '0' && character <= '9';
+}
+
+// the characters "." doesn't match
+static inline BOOL isLineBreak(UniChar character) {
+    return (character >= 0x0a && character <= 0x0d)
+        || character == 0x85 || character == 0x2028 || character == 0x2029;
+}
+
+// literal is lowercase ASCII
+static BOOL matchesLiteral(CFStringInlineBuffer *buffer, CFIndex length, CFIndex index, const char *literal) {
+    CFIndex literalLength = (CFIndex)strlen(literal);
+    if (index < 0 || index + literalLength > length) {
+        return NO;
+    }
+    for (CFIndex i = 0; i < literalLength; i++) {
+        if (lowercaseAscii(characterAt(buffer, index + i)) != (UniChar)literal[i]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+static CFIndex lineEnd(CFStringInlineBuffer *buffer, CFIndex length, CFIndex index) {
+    while (index < length && !isLineBreak(characterAt(buffer, index))) {
+        index++;
+    }
+    return index;
+}
+
+// /?(.*)
+static NSRange tailRange(CFStringInlineBuffer *buffer, CFIndex length, CFIndex index) {
+    if (index < length && characterAt(buffer, index) == '/') {
+        index++;
+    }
+    return NSMakeRange((NSUInteger)index, (NSUInteger)(lineEnd(buffer, length, index) - index));
+}
+
+#pragma mark -
+@implementation ALTLinkMatcher
+
++ (NSRange)universalLinkTailRangeInString:(NSString *)string {
+    CFIndex length = (CFIndex)string.length;
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer((CFStringRef)string, &buffer, CFRangeMake(0, length));
+
+    CFIndex prefixLength = (CFIndex)strlen(kHttpsPrefix);
+    CFIndex nextDot = -1;
+    for (CFIndex start = 0; start + prefixLength <= length; start++) {
+        if (!matchesLiteral(&buffer, length, start, kHttpsPrefix)) {
+            continue;
+        }
+        // [^.]* runs up to the first dot, which later starts share until they pass it
+        CFIndex hostStart = start + prefixLength;
+        if (nextDot < hostStart) {
+            nextDot = hostStart;
+            while (nextDot < length && characterAt(&buffer, nextDot) != '.') {
+                nextDot++;
+            }
+        }
+        if (nextDot >= length) {
+            break;
+        }
+        if (matchesLiteral(&buffer, length, nextDot, kUniversalLinkHost)) {
+            return tailRange(&buffer, length, nextDot + (CFIndex)strlen(kUniversalLinkHost));
+        }
+    }
+    return NSMakeRange(NSNotFound, 0);
+}
+
++ (NSRange)shortUniversalLinkTailRangeInString:(NSString *)string {
+    CFIndex length = (CFIndex)string.length;
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer((CFStringRef)string, &buffer, CFRangeMake(0, length));
+
+    for (CFIndex start = 0; start < length; start++) {
+        if (!matchesLiteral(&buffer, length, start, kHttpPrefix)) {
+            continue;
+        }
+        CFIndex index = start + (CFIndex)strlen(kHttpPrefix);
+        // taking the "s" is the only way "://" can follow when there is one
+        if (index < length && lowercaseAscii(characterAt(&buffer, index)) == 's') {
+            index++;
+        }
+        if (!matchesLiteral(&buffer, length, index, kSchemeDelimiter)) {
+            continue;
+        }
+        index += (CFIndex)strlen(kSchemeDelimiter);
+
+        CFIndex idEnd = index + (CFIndex)kShortLinkIdLength;
+        if (idEnd >= length) {
+            continue;
+        }
+        BOOL isId = YES;
+        for (CFIndex i = index; i < idEnd && isId; i++) {
+            UniChar character = characterAt(&buffer, i);
+            isId = isAsciiLetter(character) || isAsciiDigit(character);
+        }
+        if (!isId || characterAt(&buffer, idEnd) != '.') {
+            continue;
+        }
+        index = idEnd + 1;
+
+        // optional two letter region, tried first like the greedy group
+        if (index + 2 < length
+            && isAsciiLetter(characterAt(&buffer, index))
+            && isAsciiLetter(characterAt(&buffer, index + 1))
+            && characterAt(&buffer, index + 2) == '.'
+            && matchesLiteral(&buffer, length, index + 3, kShortLinkDomain))
+        {
+            return tailRange(&buffer, length, index + 3 + (CFIndex)strlen(kShortLinkDomain));
+        }
+        if (matchesLiteral(&buffer, length, index, kShortLinkDomain)) {
+            return tailRange(&buffer, length, index + (CFIndex)strlen(kShortLinkDomain));
+        }
+    }
+    return NSMakeRange(NSNotFound, 0);
+}
+
++ (NSUInteger)optionalRedirectMatchesInString:(NSString *)string firstRange:(NSRange *)firstRange {
+    CFIndex length = (CFIndex)string.length;
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer((CFStringRef)string, &buffer, CFRangeMake(0, length));
+
+    NSUInteger count = 0;
+    CFIndex index = 0;
+    while (index < length && count < 2) {
+        if (!matchesLiteral(&buffer, length, index, kOptionalRedirect)) {
+            index++;
+            continue;
+        }
+        CFIndex end = index + (CFIndex)strlen(kOptionalRedirect);
+        while (end < length) {
+            UniChar character = characterAt(&buffer, end);
+            if (character == '&' || character == '#') {
+                break;
+            }
+            end++;
+        }
+        if (count == 0 && firstRange != NULL) {
+            *firstRange = NSMakeRange((NSUInteger)index, (NSUInteger)(end - index));
+        }
+        count++;
+        // matches don't overlap, the next one starts after this value
+        index = end;
+    }
+    return count;
+}
+
++ (BOOL)isExcludedDeeplink:(NSString *)string {
+    CFIndex length = (CFIndex)string.length;
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer((CFStringRef)string, &buffer, CFRangeMake(0, length));
+
+    if (!matchesLiteral(&buffer, length, 0, "fb") && !matchesLiteral(&buffer, length, 0, "vk")) {
+        return NO;
+    }
+    CFIndex index = 2;
+    while (index < length && isAsciiDigit(characterAt(&buffer, index))) {
+        index++;
+    }
+    if ((NSUInteger)(index - 2) < kMinExcludedAppIdDigits) {
+        return NO;
+    }
+    // [^:]* can only end right before the first colon
+    while (index < length && characterAt(&buffer, index) != ':') {
+        index++;
+    }
+    if (!matchesLiteral(&buffer, length, index, kAuthorizeHost)) {
+        return NO;
+    }
+    index += (CFIndex)strlen(kAuthorizeHost);
+
+    CFIndex end = lineEnd(&buffer, length, index);
+    CFIndex parameterLength = (CFIndex)strlen(kAccessTokenParam);
+    for (; index + parameterLength <= end; index++) {
+        if (matchesLiteral(&buffer, length, index, kAccessTokenParam)) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
++ (NSArray<NSString *> *)pairsWithKeyPrefix:(NSString *)prefix inQuery:(NSString *)query {
+    NSMutableArray<NSString *> *pairs = [NSMutableArray array];
+    CFIndex length = (CFIndex)query.length;
+    CFIndex prefixLength = (CFIndex)prefix.length;
+    if (length == 0 || prefixLength == 0) {
+        return pairs;
+    }
+    CFStringInlineBuffer buffer;
+    CFStringInitInlineBuffer((CFStringRef)query, &buffer, CFRangeMake(0, length));
+    CFStringInlineBuffer prefixBuffer;
+    CFStringInitInlineBuffer((CFStringRef)prefix, &prefixBuffer, CFRangeMake(0, prefixLength));
+
+    CFIndex start = 0;
+    while (start < length) {
+        // a pair only counts when its key has the prefix, most are skipped right here
+        BOOL hasPrefix = start + prefixLength <= length;
+        for (CFIndex i = 0; i < prefixLength && hasPrefix; i++) {
+            hasPrefix = characterAt(&buffer, start + i) == characterAt(&prefixBuffer, i);
+        }
+
+        CFIndex end = start;
+        CFIndex separator = -1;
+        NSUInteger separatorCount = 0;
+        while (end < length) {
+            UniChar character = characterAt(&buffer, end);
+            if (character == '&') {
+                break;
+            }
+            if (character == '=') {
+                separator = end;
+                separatorCount++;
+            }
+            end++;
+        }
+
+        if (hasPrefix && separatorCount == 1 && separator >= start + prefixLength && separator + 1 < end) {
+            [pairs addObject:[query substringWithRange:NSMakeRange((NSUInteger)start, (NSUInteger)(end - start))]];
+        }
+        start = end + 1;
+    }
+    return pairs;
+}
+
+@end
@@ -1,6 +1,20 @@
 #import "ALTLinkResolution.h"
 
 static NSUInteger kMaxRecursions = 10;
+// campaign links keep pointing to the same place for much longer than this
+static const NSTimeInterval kResolvedLinkTimeToLive = 300.0;
+static const NSUInteger kMaxResolvedLinks = 32;
+
+#pragma mark - resolved link
+@interface ALTResolvedLink : NSObject
+
+@property (nonatomic, strong) NSURL *url;
+@property (nonatomic, strong) NSDate *expiresAt;
+
+@end
+
+@implementation ALTResolvedLink
+@end
 
 @interface ALTLinkResolutionDelegate : NSObject<NSURLSessionTaskDelegate>
 
@@ -91,78 +105,178 @@ static NSUInteger kMaxRecursions = 10;
         return;
     }
 
-    ALTLinkResolutionDelegate *_Nonnull linkResolutionDelegate =
-        [ALTLinkResolutionDelegate sharedInstance];
+    NSString *_Nonnull cacheKey = url.absoluteString;
+    NSMutableDictionary<NSString *, ALTResolvedLink *> *resolvedLinks = [ALTLinkResolution resolvedLinks];
+    NSMutableDictionary<NSString *, NSMutableArray *> *pendingCallbacks = [ALTLinkResolution pendingCallbacks];
+
+    @synchronized (resolvedLinks) {
+        ALTResolvedLink *_Nullable resolvedLink = [resolvedLinks objectForKey:cacheKey];
+        if (resolvedLink != nil && [resolvedLink.expiresAt timeIntervalSinceNow] > 0) {
+            NSURL *_Nonnull cachedUrl = resolvedLink.url;
+            // asynchronous like a resolution over the network
+            dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                callback(cachedUrl);
+            });
+            return;
+        }
 
-    NSURLSession *_Nonnull session =
-        [NSURLSession
-            sessionWithConfiguration:NSURLSessionConfiguration.defaultSessionConfiguration
-            delegate:linkResolutionDelegate
-            delegateQueue:nil];
+        // the same link being resolved already, wait for that one
+        NSMutableArray *_Nullable callbacks = [pendingCallbacks objectForKey:cacheKey];
+        if (callbacks != nil) {
+            [callbacks addObject:[callback copy]];
+            return;
+        }
+        [pendingCallbacks setObject:[NSMutableArray arrayWithObject:[callback copy]] forKey:cacheKey];
+    }
 
     NSURL *_Nullable httpsUrl = [ALTLinkResolutionDelegate convertUrlToHttps:url];
 
-    NSURLSessionDataTask *task =
-        [session
-            dataTaskWithURL:httpsUrl
-            completionHandler:
-                ^(NSData * _Nullable data,
-                  NSURLResponse * _Nullable response,
-                  NSError * _Nullable error)
-            {
-                // bootstrap the recursion of resolving the link
-                [ALTLinkResolution
-                    resolveLinkWithResponseUrl:response != nil ? response.URL : nil
-                    previousUrl:httpsUrl
-                    recursionNumber:0
-                    session:session
-                    callback:callback];
-            }];
-    [task resume];
+    [ALTLinkResolution
+        requestUrl:httpsUrl
+        completionHandler:^(NSURL * _Nullable responseUrl) {
+            // bootstrap the recursion of resolving the link
+            [ALTLinkResolution
+                resolveLinkWithResponseUrl:responseUrl
+                previousUrl:httpsUrl
+                recursionNumber:0
+                callback:^(NSURL * _Nullable resolvedLink, BOOL reachedLink) {
+                    [ALTLinkResolution finishResolvingWithKey:cacheKey
+                                                 resolvedLink:resolvedLink
+                                                    cacheable:reachedLink];
+                }];
+        }];
 }
 
 + (void)resolveLinkWithResponseUrl:(nullable NSURL *)responseUrl
                        previousUrl:(nullable NSURL *)previousUrl
                    recursionNumber:(NSUInteger)recursionNumber
-                           session:(nonnull NSURLSession *)session
-                          callback:(nonnull void (^)(NSURL *_Nullable resolvedLink))callback
+                          callback:(nonnull void (^)(NSURL *_Nullable resolvedLink, BOOL reachedLink))callback
 {
     // return (possible nil) previous url when the current one does not exist
     if (responseUrl == nil) {
-        callback(previousUrl);
+        callback(previousUrl, NO);
         return;
     }
 
     // return found url with expected host
     if ([ALTLinkResolution isTerminalUrlWithHost:responseUrl.host]) {
-        callback(responseUrl);
+        callback(responseUrl, YES);
         return;
     }
 
-    // return previous (non-nil) url when it reached the max number of recursive tries
+    // return previous (non-nil) url when it reached the max number of recursive tries,
+    // it never got to a terminal host, so it isn't cached either
     if (recursionNumber >= kMaxRecursions) {
-        callback(responseUrl);
+        callback(responseUrl, NO);
         return;
     }
 
     // when found a non expected url host, use it to recursively resolve the link
+    [ALTLinkResolution
+        requestUrl:responseUrl
+        completionHandler:^(NSURL * _Nullable nextResponseUrl) {
+            [ALTLinkResolution resolveLinkWithResponseUrl:nextResponseUrl
+                                              previousUrl:responseUrl
+                                          recursionNumber:(recursionNumber + 1)
+                                                 callback:callback];
+        }];
+}
+
++ (void)requestUrl:(nullable NSURL *)url
+ completionHandler:(nonnull void (^)(NSURL *_Nullable responseUrl))completionHandler
+{
+    if (url == nil) {
+        completionHandler(nil);
+        return;
+    }
+
     NSURLSessionDataTask *task =
-        [session
-            dataTaskWithURL:responseUrl
+        [[ALTLinkResolution session]
+            dataTaskWithURL:url
             completionHandler:
                 ^(NSData * _Nullable data,
                   NSURLResponse * _Nullable response,
                   NSError * _Nullable error)
-         {
-            [ALTLinkResolution resolveLinkWithResponseUrl:response != nil ? response.URL : nil
-                                              previousUrl:responseUrl
-                                          recursionNumber:(recursionNumber + 1)
-                                                  session:session
-                                                 callback:callback];
-        }];
+            {
+                completionHandler(response != nil ? response.URL : nil);
+            }];
     [task resume];
 }
 
++ (void)finishResolvingWithKey:(nonnull NSString *)cacheKey
+                  resolvedLink:(nullable NSURL *)resolvedLink
+                     cacheable:(BOOL)cacheable
+{
+    NSMutableDictionary<NSString *, ALTResolvedLink *> *resolvedLinks = [ALTLinkResolution resolvedLinks];
+    NSArray *_Nullable callbacks;
+
+    @synchronized (resolvedLinks) {
+        // a failed request only gives back the link it started from, worth trying again next time
+        if (cacheable && resolvedLink != nil) {
+            if (resolvedLinks.count >= kMaxResolvedLinks) {
+                [ALTLinkResolution removeExpiredResolvedLinks:resolvedLinks];
+            }
+            if (resolvedLinks.count >= kMaxResolvedLinks) {
+                [resolvedLinks removeAllObjects];
+            }
+            ALTResolvedLink *_Nonnull entry = [[ALTResolvedLink alloc] init];
+            entry.url = resolvedLink;
+            entry.expiresAt = [NSDate dateWithTimeIntervalSinceNow:kResolvedLinkTimeToLive];
+            [resolvedLinks setObject:entry forKey:cacheKey];
+        }
+
+        NSMutableDictionary<NSString *, NSMutableArray *> *pendingCallbacks = [ALTLinkResolution pendingCallbacks];
+        callbacks = [pendingCallbacks objectForKey:cacheKey];
+        [pendingCallbacks removeObjectForKey:cacheKey];
+    }
+
+    for (void (^callback)(NSURL *_Nullable) in callbacks) {
+        callback(resolvedLink);
+    }
+}
+
++ (void)removeExpiredResolvedLinks:(nonnull NSMutableDictionary<NSString *, ALTResolvedLink *> *)resolvedLinks {
+    NSMutableArray<NSString *> *_Nonnull expiredKeys = [NSMutableArray array];
+    for (NSString *_Nonnull key in resolvedLinks) {
+        if ([[resolvedLinks objectForKey:key].expiresAt timeIntervalSinceNow] <= 0) {
+            [expiredKeys addObject:key];
+        }
+    }
+    [resolvedLinks removeObjectsForKeys:expiredKeys];
+}
+
+// One session for all resolutions, so that its connections are reused.
++ (nonnull NSURLSession *)session {
+    static NSURLSession *session = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        session = [NSURLSession
+                    sessionWithConfiguration:NSURLSessionConfiguration.defaultSessionConfiguration
+                    delegate:[ALTLinkResolutionDelegate sharedInstance]
+                    delegateQueue:nil];
+    });
+    return session;
+}
+
+// Guarded by synchronizing on the resolved links, as are the pending callbacks.
++ (nonnull NSMutableDictionary<NSString *, ALTResolvedLink *> *)resolvedLinks {
+    static NSMutableDictionary *resolvedLinks = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        resolvedLinks = [NSMutableDictionary dictionary];
+    });
+    return resolvedLinks;
+}
+
++ (nonnull NSMutableDictionary<NSString *, NSMutableArray *> *)pendingCallbacks {
+    static NSMutableDictionary *pendingCallbacks = nil;
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        pendingCallbacks = [NSMutableDictionary dictionary];
+    });
+    return pendingCallbacks;
+}
+
 + (BOOL)isTerminalUrlWithHost:(nullable NSString *)urlHost {
     if (urlHost == nil) {
         return NO;
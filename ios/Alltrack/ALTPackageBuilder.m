@@ -10,6 +10,11 @@
 
 NSString * const ALTAttributionTokenParameter = @"attribution_token";
 
+// session callback and partner parameters are usually the same for every package
+static const NSUInteger kJsonCacheSize = 4;
+static NSMutableArray<NSDictionary *> *jsonCacheDictionaries = nil;
+static NSMutableArray<NSString *> *jsonCacheStrings = nil;
+
 @interface ALTPackageBuilder()
 
 @property (nonatomic, assign) double createdAt;
@@ -286,7 +291,8 @@ NSString * const ALTAttributionTokenParameter = @"attribution_token";
     }
 
     NSDictionary *convertedDictionary = [ALTUtil convertDictionaryValues:dictionary];
-    [ALTPackageBuilder parameters:parameters setDictionaryJson:convertedDictionary forKey:key];
+    NSString *dictionaryString = [ALTPackageBuilder cachedJsonStringWithConvertedDictionary:convertedDictionary];
+    [ALTPackageBuilder parameters:parameters setString:dictionaryString forKey:key];
 }
 
 + (void)parameters:(NSMutableDictionary *)parameters setString:(NSString *)value forKey:(NSString *)key {
@@ -1325,6 +1331,43 @@ NSString * const ALTAttributionTokenParameter = @"attribution_token";
     [ALTPackageBuilder parameters:parameters setString:dictionaryString forKey:key];
 }
 
+// Only for dictionaries made by convertDictionaryValues, nothing outside holds on to them or
+// their nested dictionaries, so a cached one can't change after its JSON was written.
++ (NSString *)cachedJsonStringWithConvertedDictionary:(NSDictionary *)dictionary {
+    static dispatch_once_t onceToken;
+    dispatch_once(&onceToken, ^{
+        jsonCacheDictionaries = [NSMutableArray arrayWithCapacity:kJsonCacheSize];
+        jsonCacheStrings = [NSMutableArray arrayWithCapacity:kJsonCacheSize];
+    });
+
+    @synchronized (jsonCacheDictionaries) {
+        for (NSUInteger i = 0; i < jsonCacheDictionaries.count; i++) {
+            if ([[jsonCacheDictionaries objectAtIndex:i] isEqualToDictionary:dictionary]) {
+                return [jsonCacheStrings objectAtIndex:i];
+            }
+        }
+    }
+
+    if (![NSJSONSerialization isValidJSONObject:dictionary]) {
+        return nil;
+    }
+    NSData *jsonData = [NSJSONSerialization dataWithJSONObject:dictionary options:0 error:nil];
+    NSString *dictionaryString = [[NSString alloc] initWithData:jsonData encoding:NSUTF8StringEncoding];
+    if (dictionaryString == nil) {
+        return nil;
+    }
+
+    @synchronized (jsonCacheDictionaries) {
+        if (jsonCacheDictionaries.count == kJsonCacheSize) {
+            [jsonCacheDictionaries removeLastObject];
+            [jsonCacheStrings removeLastObject];
+        }
+        [jsonCacheDictionaries insertObject:dictionary atIndex:0];
+        [jsonCacheStrings insertObject:dictionaryString atIndex:0];
+    }
+    return dictionaryString;
+}
+
 + (void)parameters:(NSMutableDictionary *)parameters setBool:(BOOL)value forKey:(NSString *)key {
     int valueInt = [[NSNumber numberWithBool:value] intValue];
     [ALTPackageBuilder parameters:parameters setInt:valueInt forKey:key];
@@ -2,6 +2,10 @@
 #import "ALTActivityPackage.h"
 #import "ALTLogger.h"
 #import "ALTUtil.h"
+#import "ALTStorageWriter.h"
+#import "ALTPackageQueueFile.h"
+#import "ALTExecutor.h"
+#import "ALTTimerWheel.h"
 #import "ALTAlltrackFactory.h"
 #import "ALTBackoffStrategy.h"
 #import "ALTPackageBuilder.h"
@@ -18,6 +22,7 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
 @property (nonatomic, strong) dispatch_semaphore_t sendingSemaphore;
 @property (nonatomic, strong) ALTRequestHandler *requestHandler;
 @property (nonatomic, strong) NSMutableArray *packageQueue;
+@property (nonatomic, strong) ALTPackageQueueFile *packageQueueFile;
 @property (nonatomic, strong) ALTBackoffStrategy *backoffStrategy;
 @property (nonatomic, strong) ALTBackoffStrategy *backoffStrategyForInstallSession;
 @property (nonatomic, assign) BOOL paused;
@@ -38,7 +43,8 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
     self = [super init];
     if (self == nil) return nil;
 
-    self.internalQueue = dispatch_queue_create(kInternalQueueName, DISPATCH_QUEUE_SERIAL);
+    self.internalQueue = [ALTExecutor mailboxWithName:kInternalQueueName
+                                             priority:ALTExecutorPriorityLow];
     self.backoffStrategy = [ALTAlltrackFactory packageHandlerBackoffStrategy];
     self.backoffStrategyForInstallSession = [ALTAlltrackFactory installSessionBackoffStrategy];
     self.lastPackageRetriesCount = 0;
@@ -73,6 +79,7 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
 }
 
 - (void)responseCallback:(ALTResponseData *)responseData {
+    [responseData markStage:ALTResponseStageHandler];
     if (responseData.jsonResponse) {
         [self.logger debug:@"Got JSON response with message: %@", responseData.message];
     } else {
@@ -94,11 +101,11 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
 - (void)sendNextPackage:(ALTResponseData *)responseData {
     self.lastPackageRetriesCount = 0;
 
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTPackageHandler* selfI) {
-                         [selfI sendNextI:selfI];
-                     }];
+    [ALTUtil launchInOwnQueue:self.internalQueue
+                   selfInject:self
+                        block:^(ALTPackageHandler* selfI) {
+                            [selfI sendNextI:selfI];
+                        }];
 
     [self.activityHandler finishedTracking:responseData];
 }
@@ -119,16 +126,15 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
     NSString *waitTimeFormatted = [ALTUtil secondsNumberFormat:waitTime];
 
     [self.logger verbose:@"Waiting for %@ seconds before retrying the %d time", waitTimeFormatted, self.lastPackageRetriesCount];
-    dispatch_after
-        (dispatch_time(DISPATCH_TIME_NOW, (int64_t)(waitTime * NSEC_PER_SEC)),
-         self.internalQueue,
-         ^{
-            [self.logger verbose:@"Package handler finished waiting"];
+    [[ALTTimerWheel sharedWheel] scheduleBlock:^{
+        [self.logger verbose:@"Package handler finished waiting"];
 
-            dispatch_semaphore_signal(self.sendingSemaphore);
+        dispatch_semaphore_signal(self.sendingSemaphore);
 
-            [self sendFirstPackage];
-        });
+        [self sendFirstPackage];
+    }
+                                         queue:self.internalQueue
+                                         after:waitTime];
 }
 
 - (void)pauseSending {
@@ -176,6 +182,8 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
 }
 
 + (void)deletePackageQueue {
+    // a write still in flight would bring the file back
+    [[ALTStorageWriter sharedWriter] flush];
     [ALTUtil deleteFileWithName:kPackageQueueFilename];
 }
 
@@ -193,9 +201,14 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
                                 initWithResponseCallback:self
                                 urlStrategy:urlStrategy
                                 userAgent:userAgent
-                                requestTimeout:[ALTAlltrackFactory requestTimeout]];
+                                requestTimeout:[ALTAlltrackFactory requestTimeout]
+                                callbackQueue:selfI.internalQueue];
+    selfI.requestHandler.compressesRequestBodies =
+        [[activityHandler alltrackConfig] requestBodyCompressionEnabled];
     selfI.logger = ALTAlltrackFactory.logger;
     selfI.sendingSemaphore = dispatch_semaphore_create(1);
+    selfI.packageQueueFile = [ALTPackageQueueFile queueFileWithName:kPackageQueueFilename
+                                                         objectName:@"Package queue"];
     [selfI readPackageQueueI:selfI];
 }
 
@@ -207,7 +220,7 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
     [selfI.logger debug:@"Added package %d (%@)", selfI.packageQueue.count, newPackage];
     [selfI.logger verbose:@"%@", newPackage.extendedString];
 
-    [selfI writePackageQueueS:selfI];
+    [selfI appendToPackageQueueS:selfI package:newPackage];
 }
 
 - (void)sendFirstI:(ALTPackageHandler *)selfI
@@ -248,8 +261,9 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
 
 - (void)sendNextI:(ALTPackageHandler *)selfI {
     if ([selfI.packageQueue count] > 0) {
+        id package = [selfI.packageQueue objectAtIndex:0];
         [selfI.packageQueue removeObjectAtIndex:0];
-        [selfI writePackageQueueS:selfI];
+        [selfI removeFromPackageQueueS:selfI package:package];
     }
 
     dispatch_semaphore_signal(selfI.sendingSemaphore);
@@ -283,6 +297,8 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
                                forKey:@"partner_params"];
     }
 
+    // every package changed, none of the records written before still fits
+    [selfI.packageQueueFile discardRecords];
     [selfI writePackageQueueS:selfI];
 }
 
@@ -294,14 +310,30 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
 #pragma mark - private
 - (void)readPackageQueueI:(ALTPackageHandler *)selfI {
     [NSKeyedUnarchiver setClass:[ALTActivityPackage class] forClassName:@"AIActivityPackage"];
+    // the previous instance may not be done writing yet
+    [[ALTStorageWriter sharedWriter] flush];
     
+    NSMutableArray *packages;
+    @synchronized ([ALTPackageHandler class]) {
+        packages = [selfI.packageQueueFile readPackages];
+    }
+    if (packages != nil) {
+        [selfI.logger debug:@"Package handler read %d packages", packages.count];
+        selfI.packageQueue = packages;
+        return;
+    }
+
+    // written before packages were stored as records, converted with the next write
     id object = [ALTUtil readObject:kPackageQueueFilename
                          objectName:@"Package queue"
                               class:[NSArray class]
                          syncObject:[ALTPackageHandler class]];
     
     if (object != nil) {
-        selfI.packageQueue = object;
+        selfI.packageQueue = [object isKindOfClass:[NSMutableArray class]] ? object : [object mutableCopy];
+        // converted right away, so the legacy archive is decoded only on this launch
+        [selfI.logger verbose:@"Converting legacy package queue of %d packages", selfI.packageQueue.count];
+        [selfI writePackageQueueS:selfI];
     } else {
         selfI.packageQueue = [NSMutableArray array];
     }
@@ -309,14 +341,68 @@ static const char * const kInternalQueueName    = "io.alltrack.PackageQueue";
 }
 
 - (void)writePackageQueueS:(ALTPackageHandler *)selfS {
-    if (selfS.packageQueue == nil) {
-        return;
+#if TARGET_OS_TV
+    return;
+#endif
+    id<ALTLogger> logger = selfS.logger;
+    @synchronized ([ALTPackageHandler class]) {
+        if (selfS.packageQueue == nil) {
+            return;
+        }
+        // only packages not written before are archived here, the file is written on the storage queue
+        NSUInteger count = selfS.packageQueue.count;
+        [selfS.packageQueueFile writePackages:selfS.packageQueue
+                                   completion:^(BOOL written) {
+                                       if (written) {
+                                           [logger debug:@"Package handler wrote %d packages", count];
+                                       }
+                                   }];
     }
-    
-    [ALTUtil writeObject:selfS.packageQueue
-                fileName:kPackageQueueFilename
-              objectName:@"Package queue"
-              syncObject:[ALTPackageHandler class]];
+}
+
+- (void)appendToPackageQueueS:(ALTPackageHandler *)selfS
+                      package:(ALTActivityPackage *)package {
+#if TARGET_OS_TV
+    return;
+#endif
+    id<ALTLogger> logger = selfS.logger;
+    @synchronized ([ALTPackageHandler class]) {
+        if (selfS.packageQueue == nil) {
+            return;
+        }
+        NSUInteger count = selfS.packageQueue.count;
+        [selfS.packageQueueFile appendPackage:package
+                                   completion:^(BOOL written) {
+                                       if (written) {
+                                           [logger debug:@"Package handler wrote %d packages", count];
+                                       }
+                                   }];
+    }
+}
+
+- (void)removeFromPackageQueueS:(ALTPackageHandler *)selfS
+                        package:(id)package {
+#if TARGET_OS_TV
+    return;
+#endif
+    id<ALTLogger> logger = selfS.logger;
+    @synchronized ([ALTPackageHandler class]) {
+        if (selfS.packageQueue == nil) {
+            return;
+        }
+        NSUInteger count = selfS.packageQueue.count;
+        BOOL removed = [selfS.packageQueueFile removeFirstPackage:package
+                                                       completion:^(BOOL written) {
+                                                           if (written) {
+                                                               [logger debug:@"Package handler wrote %d packages", count];
+                                                           }
+                                                       }];
+        if (removed) {
+            return;
+        }
+    }
+    // not the first package in the file, e.g. one that changed since it was written
+    [selfS writePackageQueueS:selfS];
 }
 
 - (void)teardownPackageQueueS {
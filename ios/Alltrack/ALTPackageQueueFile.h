@@ -0,0 +1,43 @@
+#import <Foundation/Foundation.h>
+
+@class ALTActivityPackage;
+
+// Package queue file where every package is its own record, framed with its length and a
+// CRC32C of its content. A damaged record costs only that package instead of the whole
+// queue, and a torn tail is cut off at the last complete record. Archives are deflated
+// against a dictionary of the strings every package repeats, which ships with the SDK.
+// A package is archived and deflated once, later writes of the queue reuse its record.
+// Added packages are appended to the file. A package leaving the head of the queue appends a
+// tombstone, the file is only compacted once enough of it is dead, and is rewritten when
+// packages change.
+@interface ALTPackageQueueFile : NSObject
+
++ (ALTPackageQueueFile *)queueFileWithName:(NSString *)fileName
+                                objectName:(NSString *)objectName;
+
+// Returns nil if there is no file or it isn't in the record format, the caller then falls
+// back to the legacy archive of the whole queue.
+- (NSMutableArray *)readPackages;
+
+// Replaces the file with the packages on the storage queue.
+- (void)writePackages:(NSArray *)packages
+           completion:(void (^)(BOOL written))completion;
+
+// Adds the package after the ones written before, without writing those again.
+- (void)appendPackage:(ALTActivityPackage *)package
+           completion:(void (^)(BOOL written))completion;
+
+// Removes the package at the head of the file with a tombstone. Returns NO without writing
+// anything when the package isn't the first one in the file, the queue then has to be
+// written as a whole.
+- (BOOL)removeFirstPackage:(id)package
+                completion:(void (^)(BOOL written))completion;
+
+// For packages changed after they were written, their next write archives them again.
+- (void)discardRecordOfPackage:(ALTActivityPackage *)package;
+
+- (void)discardRecords;
+
++ (uint32_t)crc32c:(const void *)bytes length:(size_t)length;
+
+@end
@@ -0,0 +1,634 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#elif defined(__SSE4_2__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#define ALT_CRC32C_SSE42 1
+#endif
+
+#import "ALTPackageQueueFile.h"
+#import "ALTActivityPackage.h"
+#import "ALTAlltrackFactory.h"
+#import "ALTStorageWriter.h"
+#import "ALTUtil.h"
+
+static const uint32_t kFileMagic = 0x414c5451; // "ALTQ"
+static const uint32_t kFileVersion = 3;
+// no tombstones, rewritten in the current version before anything is appended
+static const uint32_t kCompressedFileVersion = 2;
+// records hold the archive itself, without the compression header
+static const uint32_t kUncompressedFileVersion = 1;
+// marks a tombstone instead of an archive length in the payload header
+static const uint32_t kTombstoneMarker = 0xffffffff;
+// dequeues only append tombstones until this much of the file is dead, and more of it is
+// dead than alive, the file is then rewritten with only the queued packages
+static const unsigned long long kCompactionThreshold = 64 * 1024;
+
+// Strings found in most archived packages, so the compressor can refer back to them from the
+// first byte of every record on. The most common ones go last, closest to the data. Records
+// are bound to it by its checksum, changing it needs a new file version.
+static const char kCompressionDictionary[] =
+    "productionsandboxiPhoneiPadphonetabletiosreact_native@iosZ+0000T00:00:00.000Z"
+    "ad_revenue_networkad_revenue_unitad_revenue_placementad_impressions_countbilling_store"
+    "transaction_idtransaction_datepurchase_timesales_regionreceiptdeduplication_id"
+    "granular_third_party_sharing_optionspartner_sharing_settingssharingmeasurement"
+    "push_tokenfb_anon_idexternal_device_idskadn_registered_atff_skadn_disabledff_idfa_disabled"
+    "ff_iad_disabledff_adserv_disabledff_coppaneeds_costinitiated_byerror_codedetailspayload"
+    "click_timereftagdeeplinksourceapple_adsiad3trackercampaignadgroupcreative"
+    "revenuecurrencyevent_tokenevent_countevent_callback_idcallback_paramspartner_params"
+    "default_trackerlast_intervaltime_spentsession_lengthsubsession_countsession_count"
+    "secondary_dedupe_tokenprimary_dedupe_tokenidfaidfvatt_statustracking_enabled"
+    "event_buffering_enabledattribution_deeplinkneeds_response_detailsenvironment"
+    "device_typedevice_nameos_nameos_versionbundle_idapp_version_shortapp_version"
+    "installed_atstarted_atcreated_atsent_atapp_token"
+    "/sdk_info/ad_revenue/gdpr_forget_device/third_party_sharing/attribution/sdk_click/event/session"
+    "NSKeyedArchiver$version$archiver$toproot$objects$null$class$classname$classes"
+    "NSObjectNSDictionaryNSMutableDictionaryNS.keysNS.objectsALTActivityPackage"
+    "pathkindsuffixclientSdkparameterscallbackParameterspartnerParameters";
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+} ALTPackageQueueFileHeader;
+
+typedef struct {
+    uint32_t length;
+    uint32_t checksum;
+} ALTPackageQueueRecordHeader;
+
+// leads the payload of every record since version 2
+typedef struct {
+    // length of the archive once inflated, 0 if it is stored as it is
+    uint32_t archiveLength;
+} ALTPackageQueuePayloadHeader;
+
+// payload of a tombstone, the packages at the head of the queue it removes
+typedef struct {
+    ALTPackageQueuePayloadHeader payloadHeader;
+    uint32_t count;
+} ALTPackageQueueTombstone;
+
+#if !defined(__ARM_FEATURE_CRC32) && !defined(ALT_CRC32C_SSE42)
+// reflected Castagnoli polynomial
+static const uint32_t kCrc32cPolynomial = 0x82f63b78;
+static uint32_t crc32cTable[256];
+#endif
+
+#pragma mark - private
+@interface ALTPackageQueueFile()
+
+@property (nonatomic, copy) NSString *fileName;
+@property (nonatomic, copy) NSString *objectName;
+// record of every package in the last write, by identity, guarded by self
+@property (nonatomic, strong) NSMapTable *records;
+// what the file holds once the pending commit is done, in order
+@property (nonatomic, strong) NSMutableArray<NSData *> *fileRecords;
+// added since the last commit, at the end of the file records
+@property (nonatomic, strong) NSMutableArray<NSData *> *appendedRecords;
+@property (nonatomic, assign) BOOL rewritePending;
+// bytes of removed records and tombstones still in the file
+@property (nonatomic, assign) unsigned long long deadBytes;
+// the file on disk is in the current format and ends with the last committed record
+@property (nonatomic, assign) BOOL appendable;
+// only touched on the storage queue once the file was read
+@property (nonatomic, assign) unsigned long long fileSize;
+
+@end
+
+#pragma mark -
+@implementation ALTPackageQueueFile
+
++ (void)initialize {
+    if (self != [ALTPackageQueueFile class]) return;
+#if !defined(__ARM_FEATURE_CRC32) && !defined(ALT_CRC32C_SSE42)
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? kCrc32cPolynomial : 0);
+        }
+        crc32cTable[i] = crc;
+    }
+#endif
+}
+
++ (ALTPackageQueueFile *)queueFileWithName:(NSString *)fileName
+                                objectName:(NSString *)objectName {
+    return [[ALTPackageQueueFile alloc] initWithName:fileName objectName:objectName];
+}
+
+- (id)initWithName:(NSString *)fileName
+        objectName:(NSString *)objectName {
+    self = [super init];
+    if (self == nil) return nil;
+
+    self.fileName = fileName;
+    self.objectName = objectName;
+    self.records = [ALTPackageQueueFile recordTable];
+    self.fileRecords = [NSMutableArray array];
+    self.appendedRecords = [NSMutableArray array];
+    self.rewritePending = NO;
+    self.deadBytes = 0;
+    self.appendable = NO;
+    self.fileSize = 0;
+
+    return self;
+}
+
+- (NSMutableArray *)readPackages {
+    NSString *path = [ALTUtil getFilePathInAppSupportDir:self.fileName];
+    if (path == nil) {
+        return nil;
+    }
+    NSData *data = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+    if (data == nil || data.length < sizeof(ALTPackageQueueFileHeader)) {
+        return nil;
+    }
+    ALTPackageQueueFileHeader fileHeader;
+    [data getBytes:&fileHeader length:sizeof(fileHeader)];
+    if (fileHeader.magic != kFileMagic
+        || (fileHeader.version != kFileVersion
+            && fileHeader.version != kCompressedFileVersion
+            && fileHeader.version != kUncompressedFileVersion))
+    {
+        return nil;
+    }
+
+    NSMutableArray *packages = [NSMutableArray array];
+    NSMapTable *records = [ALTPackageQueueFile recordTable];
+    NSMutableArray<NSData *> *fileRecords = [NSMutableArray array];
+    unsigned long long deadBytes = 0;
+    // records of older versions can't be followed by current ones
+    BOOL appendable = fileHeader.version == kFileVersion;
+    const uint8_t *bytes = data.bytes;
+    NSUInteger offset = sizeof(fileHeader);
+    while (offset + sizeof(ALTPackageQueueRecordHeader) <= data.length) {
+        ALTPackageQueueRecordHeader header;
+        memcpy(&header, bytes + offset, sizeof(header));
+        NSUInteger payloadOffset = offset + sizeof(header);
+        // an empty record is never written, a zeroed tail left by a crash would pass the
+        // checksum though, since the CRC32C of nothing is 0
+        if (header.length == 0
+            || header.length > data.length - payloadOffset
+            || [ALTPackageQueueFile crc32c:bytes + payloadOffset length:header.length] != header.checksum)
+        {
+            break;
+        }
+
+        uint32_t tombstoneCount = 0;
+        if (fileHeader.version == kFileVersion
+            && [ALTPackageQueueFile isTombstone:bytes + payloadOffset length:header.length count:&tombstoneCount])
+        {
+            NSUInteger removed = MIN((NSUInteger)tombstoneCount, fileRecords.count);
+            for (NSUInteger i = 0; i < removed; i++) {
+                deadBytes += fileRecords[i].length;
+                [records removeObjectForKey:packages[i]];
+            }
+            [packages removeObjectsInRange:NSMakeRange(0, removed)];
+            [fileRecords removeObjectsInRange:NSMakeRange(0, removed)];
+            deadBytes += sizeof(header) + header.length;
+            offset = payloadOffset + header.length;
+            continue;
+        }
+
+        @autoreleasepool {
+            NSData *archive;
+            if (fileHeader.version == kUncompressedFileVersion) {
+                archive = [NSData dataWithBytesNoCopy:(void *)(bytes + payloadOffset)
+                                               length:header.length
+                                         freeWhenDone:NO];
+            } else {
+                archive = [ALTPackageQueueFile archiveFromPayload:bytes + payloadOffset length:header.length];
+            }
+            ALTActivityPackage *package = archive != nil
+                ? [ALTUtil unarchiveData:archive class:[ALTActivityPackage class]]
+                : nil;
+            if (package != nil) {
+                // copied out of the mapping, written as it is with the next rewrite;
+                // records of older versions are redone in the current one
+                NSData *record = fileHeader.version != kUncompressedFileVersion
+                    ? [NSData dataWithBytes:bytes + offset length:sizeof(header) + header.length]
+                    : [ALTPackageQueueFile recordWithPackage:package];
+                if (record != nil) {
+                    [packages addObject:package];
+                    [records setObject:record forKey:package];
+                    [fileRecords addObject:record];
+                }
+            } else {
+                // intact but unreadable, the framing still leads to the next one; rewritten
+                // without it, so that tombstones only ever count the records read back
+                [[ALTAlltrackFactory logger] error:@"Skipping unreadable package in the package queue"];
+                appendable = NO;
+            }
+        }
+        offset = payloadOffset + header.length;
+    }
+
+    if (offset < data.length) {
+        // everything before the damage is kept
+        [[ALTAlltrackFactory logger] warn:@"Dropping %lu bytes of incomplete package queue data",
+         (unsigned long)(data.length - offset)];
+        // appending after the damage would hide the new records from the next read
+        appendable = appendable && truncate([path fileSystemRepresentation], (off_t)offset) == 0;
+    }
+    @synchronized (self) {
+        self.records = records;
+        self.fileRecords = fileRecords;
+        [self.appendedRecords removeAllObjects];
+        self.deadBytes = deadBytes;
+        self.appendable = appendable;
+        self.fileSize = offset;
+    }
+    return packages;
+}
+
+- (void)writePackages:(NSArray *)packages
+           completion:(void (^)(BOOL written))completion {
+    NSString *filePath = [self filePathForWrite:completion];
+    if (filePath == nil) {
+        return;
+    }
+
+    @synchronized (self) {
+        // rebuilt with every write, records of packages no longer queued go away with it
+        NSMapTable *records = [ALTPackageQueueFile recordTable];
+        NSMutableArray<NSData *> *fileRecords = [NSMutableArray arrayWithCapacity:packages.count];
+        for (id package in packages) {
+            if (![package isKindOfClass:[ALTActivityPackage class]]) {
+                // only legacy archives can hold these, they would never be sent
+                continue;
+            }
+            NSData *record = [self recordOfPackage:package];
+            if (record == nil) {
+                continue;
+            }
+            [records setObject:record forKey:package];
+            [fileRecords addObject:record];
+        }
+        self.records = records;
+        self.fileRecords = fileRecords;
+        [self.appendedRecords removeAllObjects];
+        self.rewritePending = YES;
+    }
+    [self submitCommitToPath:filePath completion:completion];
+}
+
+- (void)appendPackage:(ALTActivityPackage *)package
+           completion:(void (^)(BOOL written))completion {
+    NSString *filePath = [self filePathForWrite:completion];
+    if (filePath == nil) {
+        return;
+    }
+
+    @synchronized (self) {
+        NSData *record = [self recordOfPackage:package];
+        if (record == nil) {
+            if (completion != nil) {
+                completion(NO);
+            }
+            return;
+        }
+        [self.records setObject:record forKey:package];
+        [self.fileRecords addObject:record];
+        [self.appendedRecords addObject:record];
+    }
+    [self submitCommitToPath:filePath completion:completion];
+}
+
+- (BOOL)removeFirstPackage:(id)package
+                completion:(void (^)(BOOL written))completion {
+    NSString *filePath = [ALTUtil getFilePathInAppSupportDir:self.fileName];
+    if (filePath == nil || package == nil) {
+        return NO;
+    }
+
+    @synchronized (self) {
+        NSData *record = [self.records objectForKey:package];
+        if (record == nil || self.fileRecords.count == 0 || self.fileRecords[0] != record) {
+            return NO;
+        }
+        [self.records removeObjectForKey:package];
+        [self.fileRecords removeObjectAtIndex:0];
+
+        NSData *tombstone = [ALTPackageQueueFile tombstoneRecordWithCount:1];
+        self.deadBytes += record.length + tombstone.length;
+        if (self.deadBytes >= kCompactionThreshold && self.deadBytes > [self liveBytes]) {
+            self.rewritePending = YES;
+        } else {
+            [self.appendedRecords addObject:tombstone];
+        }
+    }
+    [self submitCommitToPath:filePath completion:completion];
+    return YES;
+}
+
+- (void)discardRecordOfPackage:(ALTActivityPackage *)package {
+    if (package == nil) {
+        return;
+    }
+    @synchronized (self) {
+        [self.records removeObjectForKey:package];
+    }
+}
+
+- (void)discardRecords {
+    @synchronized (self) {
+        [self.records removeAllObjects];
+    }
+}
+
+#pragma mark - writes
+
+- (NSString *)filePathForWrite:(void (^)(BOOL written))completion {
+    NSString *filePath = [ALTUtil getFilePathInAppSupportDir:self.fileName];
+    if (filePath == nil) {
+        [[ALTAlltrackFactory logger] error:@"Cannot get filepath from filename: %@, to write %@ file",
+         self.fileName, self.objectName];
+        if (completion != nil) {
+            completion(NO);
+        }
+    }
+    return filePath;
+}
+
+- (unsigned long long)liveBytes {
+    unsigned long long liveBytes = 0;
+    for (NSData *record in self.fileRecords) {
+        liveBytes += record.length;
+    }
+    return liveBytes;
+}
+
+- (NSData *)recordOfPackage:(ALTActivityPackage *)package {
+    NSData *record = [self.records objectForKey:package];
+    if (record != nil) {
+        return record;
+    }
+    return [ALTPackageQueueFile recordWithPackage:package];
+}
+
+- (void)submitCommitToPath:(NSString *)filePath
+                completion:(void (^)(BOOL written))completion {
+    __weak ALTPackageQueueFile *weakSelf = self;
+    [[ALTStorageWriter sharedWriter] submitWriteForKey:self.fileName
+                                                 block:^BOOL{
+                                                     ALTPackageQueueFile *strongSelf = weakSelf;
+                                                     if (strongSelf == nil) {
+                                                         return NO;
+                                                     }
+                                                     return [strongSelf commitToPathI:filePath];
+                                                 }
+                                            completion:completion];
+}
+
+// Runs on the storage queue. Whatever was written or appended since the last run is covered
+// by one commit, newly added packages are appended unless the file has to be rewritten anyway.
+- (BOOL)commitToPathI:(NSString *)filePath {
+    NSArray<NSData *> *appendedRecords = nil;
+    @synchronized (self) {
+        if (!self.rewritePending && self.appendedRecords.count == 0) {
+            // an earlier run already took care of it
+            return YES;
+        }
+        if (!self.rewritePending && self.appendable) {
+            appendedRecords = [self.appendedRecords copy];
+            [self.appendedRecords removeAllObjects];
+        }
+    }
+
+    if (appendedRecords != nil) {
+        if ([self appendRecordsI:appendedRecords toPath:filePath]) {
+            return YES;
+        }
+        // the file is left as it was, or is gone, rewriting it puts everything back
+        [[ALTAlltrackFactory logger] debug:@"Failed to append to %@ file (%d)", self.objectName, errno];
+    }
+
+    NSArray<NSData *> *records;
+    @synchronized (self) {
+        records = [self.fileRecords copy];
+        [self.appendedRecords removeAllObjects];
+        self.rewritePending = NO;
+        // only the records still queued are written, removals after this count from here
+        self.deadBytes = 0;
+    }
+    BOOL written = [self replaceFileI:filePath withRecords:records];
+    @synchronized (self) {
+        self.appendable = written;
+        if (!written) {
+            // retried with the next commit
+            self.rewritePending = YES;
+        }
+    }
+    if (!written) {
+        [[ALTAlltrackFactory logger] error:@"Failed to write %@ file", self.objectName];
+    }
+    return written;
+}
+
+- (BOOL)appendRecordsI:(NSArray<NSData *> *)records toPath:(NSString *)filePath {
+    // no O_CREAT, a file deleted meanwhile has lost the records before these
+    int fd = open([filePath fileSystemRepresentation], O_WRONLY | O_APPEND);
+    if (fd < 0) {
+        return NO;
+    }
+    BOOL written = [ALTStorageWriter writeBuffers:records toFileDescriptor:fd]
+        && [ALTStorageWriter syncFileDescriptor:fd];
+    if (!written) {
+        // leave no partial record behind for the next append to follow
+        ftruncate(fd, (off_t)self.fileSize);
+    }
+    close(fd);
+    if (written) {
+        for (NSData *record in records) {
+            self.fileSize += record.length;
+        }
+    }
+    return written;
+}
+
+- (BOOL)replaceFileI:(NSString *)filePath withRecords:(NSArray<NSData *> *)records {
+    ALTPackageQueueFileHeader fileHeader;
+    fileHeader.magic = kFileMagic;
+    fileHeader.version = kFileVersion;
+    NSMutableArray<NSData *> *buffers = [NSMutableArray arrayWithCapacity:records.count + 1];
+    [buffers addObject:[NSData dataWithBytes:&fileHeader length:sizeof(fileHeader)]];
+    [buffers addObjectsFromArray:records];
+
+    // the records go to the kernel as they are, without being copied together
+    if (![ALTStorageWriter replaceFileAtPath:filePath withBuffers:buffers]) {
+        return NO;
+    }
+    [ALTUtil excludeFromBackup:filePath];
+
+    unsigned long long fileSize = 0;
+    for (NSData *buffer in buffers) {
+        fileSize += buffer.length;
+    }
+    self.fileSize = fileSize;
+    return YES;
+}
+
+#pragma mark - records
+
++ (NSMapTable *)recordTable {
+    // packages don't implement equality, the same package is the same object
+    return [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality
+                                     valueOptions:NSPointerFunctionsStrongMemory
+                                         capacity:0];
+}
+
++ (NSData *)recordWithPackage:(ALTActivityPackage *)package {
+    // archiver temporaries are released per package, a large legacy queue doesn't pile them up
+    @autoreleasepool {
+        NSData *archive = [ALTUtil archiveObject:package];
+        if (archive == nil) {
+            [[ALTAlltrackFactory logger] error:@"Failed to archive package %@", package];
+            return nil;
+        }
+        NSData *compressedArchive = [ALTPackageQueueFile compressArchive:archive];
+        ALTPackageQueuePayloadHeader payloadHeader;
+        payloadHeader.archiveLength = compressedArchive != nil ? (uint32_t)archive.length : 0;
+        NSData *content = compressedArchive != nil ? compressedArchive : archive;
+
+        ALTPackageQueueRecordHeader header;
+        header.length = (uint32_t)(sizeof(payloadHeader) + content.length);
+        NSMutableData *record = [NSMutableData dataWithCapacity:sizeof(header) + header.length];
+        [record appendBytes:&header length:sizeof(header)];
+        [record appendBytes:&payloadHeader length:sizeof(payloadHeader)];
+        [record appendData:content];
+
+        uint8_t *payload = (uint8_t *)record.mutableBytes + sizeof(header);
+        header.checksum = [ALTPackageQueueFile crc32c:payload length:header.length];
+        [record replaceBytesInRange:NSMakeRange(0, sizeof(header)) withBytes:&header];
+        return record;
+    }
+}
+
++ (NSData *)tombstoneRecordWithCount:(uint32_t)count {
+    ALTPackageQueueTombstone tombstone;
+    tombstone.payloadHeader.archiveLength = kTombstoneMarker;
+    tombstone.count = count;
+
+    ALTPackageQueueRecordHeader header;
+    header.length = sizeof(tombstone);
+    header.checksum = [ALTPackageQueueFile crc32c:&tombstone length:sizeof(tombstone)];
+    NSMutableData *record = [NSMutableData dataWithCapacity:sizeof(header) + sizeof(tombstone)];
+    [record appendBytes:&header length:sizeof(header)];
+    [record appendBytes:&tombstone length:sizeof(tombstone)];
+    return record;
+}
+
++ (BOOL)isTombstone:(const uint8_t *)payload length:(NSUInteger)length count:(uint32_t *)count {
+    if (length != sizeof(ALTPackageQueueTombstone)) {
+        return NO;
+    }
+    ALTPackageQueueTombstone tombstone;
+    memcpy(&tombstone, payload, sizeof(tombstone));
+    if (tombstone.payloadHeader.archiveLength != kTombstoneMarker) {
+        return NO;
+    }
+    *count = tombstone.count;
+    return YES;
+}
+
+#pragma mark - compression
+
+// nil if it fails or doesn't make the archive smaller
++ (NSData *)compressArchive:(NSData *)archive {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // the queue is rewritten often, the dictionary gets most of the gain even at the fastest level
+    if (deflateInit(&stream, Z_BEST_SPEED) != Z_OK) {
+        return nil;
+    }
+    if (deflateSetDictionary(&stream, (const Bytef *)kCompressionDictionary,
+                             sizeof(kCompressionDictionary) - 1) != Z_OK)
+    {
+        deflateEnd(&stream);
+        return nil;
+    }
+    uLong bound = deflateBound(&stream, (uLong)archive.length);
+    NSMutableData *compressed = [NSMutableData dataWithLength:bound];
+    stream.next_in = (Bytef *)archive.bytes;
+    stream.avail_in = (uInt)archive.length;
+    stream.next_out = (Bytef *)compressed.mutableBytes;
+    stream.avail_out = (uInt)bound;
+    int status = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END || stream.total_out >= archive.length) {
+        return nil;
+    }
+    [compressed setLength:stream.total_out];
+    return compressed;
+}
+
++ (NSData *)archiveFromPayload:(const uint8_t *)bytes length:(NSUInteger)length {
+    if (length < sizeof(ALTPackageQueuePayloadHeader)) {
+        return nil;
+    }
+    ALTPackageQueuePayloadHeader payloadHeader;
+    memcpy(&payloadHeader, bytes, sizeof(payloadHeader));
+    bytes += sizeof(payloadHeader);
+    length -= sizeof(payloadHeader);
+    if (payloadHeader.archiveLength == 0) {
+        return [NSData dataWithBytesNoCopy:(void *)bytes length:length freeWhenDone:NO];
+    }
+
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (inflateInit(&stream) != Z_OK) {
+        return nil;
+    }
+    NSMutableData *archive = [NSMutableData dataWithLength:payloadHeader.archiveLength];
+    stream.next_in = (Bytef *)bytes;
+    stream.avail_in = (uInt)length;
+    stream.next_out = (Bytef *)archive.mutableBytes;
+    stream.avail_out = payloadHeader.archiveLength;
+    int status = inflate(&stream, Z_FINISH);
+    if (status == Z_NEED_DICT
+        && inflateSetDictionary(&stream, (const Bytef *)kCompressionDictionary,
+                                sizeof(kCompressionDictionary) - 1) == Z_OK)
+    {
+        status = inflate(&stream, Z_FINISH);
+    }
+    inflateEnd(&stream);
+    if (status != Z_STREAM_END || stream.total_out != payloadHeader.archiveLength) {
+        return nil;
+    }
+    return archive;
+}
+
+#pragma mark - checksum
+
++ (uint32_t)crc32c:(const void *)bytes length:(size_t)length {
+    const uint8_t *data = (const uint8_t *)bytes;
+    uint32_t crc = 0xffffffff;
+#if defined(__ARM_FEATURE_CRC32)
+    for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t), data += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = __crc32cd(crc, word);
+    }
+    for (; length > 0; length--, data++) {
+        crc = __crc32cb(crc, *data);
+    }
+#elif defined(ALT_CRC32C_SSE42)
+    for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t), data += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc = (uint32_t)_mm_crc32_u64(crc, word);
+    }
+    for (; length > 0; length--, data++) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+#else
+    for (; length > 0; length--, data++) {
+        crc = (crc >> 8) ^ crc32cTable[(crc ^ *data) & 0xff];
+    }
+#endif
+    return crc ^ 0xffffffff;
+}
+
+@end
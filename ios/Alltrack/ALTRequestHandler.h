@@ -13,6 +13,20 @@
                      userAgent:(NSString *)userAgent
                 requestTimeout:(double)requestTimeout;
 
+// Responses are delivered on the callback queue, usually the mailbox of the response callback.
+- (id)initWithResponseCallback:(id<ALTResponseCallback>)responseCallback
+                   urlStrategy:(ALTUrlStrategy *)urlStrategy
+                     userAgent:(NSString *)userAgent
+                requestTimeout:(double)requestTimeout
+                 callbackQueue:(dispatch_queue_t)callbackQueue;
+
+// POST bodies above a threshold are sent gzip encoded. Off unless the endpoint accepts it.
+@property (nonatomic, assign) BOOL compressesRequestBodies;
+
+// GET requests carry the ETag of the last response for their path in If-None-Match. A 304 is
+// delivered as that response again, marked as not modified.
+@property (nonatomic, assign) BOOL revalidatesGetResponses;
+
 - (void)sendPackageByPOST:(ALTActivityPackage *)activityPackage
         sendingParameters:(NSDictionary *)sendingParameters;
 
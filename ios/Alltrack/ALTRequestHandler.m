@@ -6,9 +6,13 @@
 #import "ALTActivityPackage.h"
 #import "NSString+ALTAdditions.h"
 #include <stdlib.h>
+#include <zlib.h>
 
 static NSString * const ALTMethodGET = @"MethodGET";
 static NSString * const ALTMethodPOST = @"MethodPOST";
+// smaller bodies don't gain enough to pay for the compression and the header
+static const NSUInteger kBodyCompressionThreshold = 1024;
+static const NSUInteger kBodyCompressionChunkSize = 16 * 1024;
 
 @interface ALTRequestHandler()
 
@@ -21,8 +25,14 @@ static NSString * const ALTMethodPOST = @"MethodPOST";
 
 @property (nonatomic, copy) NSURLSessionConfiguration *defaultSessionConfiguration;
 
+@property (nonatomic, strong) NSOperationQueue *delegateQueue;
+
 @property (nonatomic, strong) NSHashTable<NSString *> *exceptionKeys;
 
+// by path, for revalidating GET responses
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSString *> *entityTags;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSDictionary *> *validatedResponses;
+
 @end
 
 @implementation ALTRequestHandler
@@ -33,6 +43,19 @@ static NSString * const ALTMethodPOST = @"MethodPOST";
                    urlStrategy:(ALTUrlStrategy *)urlStrategy
                      userAgent:(NSString *)userAgent
                 requestTimeout:(double)requestTimeout
+{
+    return [self initWithResponseCallback:responseCallback
+                              urlStrategy:urlStrategy
+                                userAgent:userAgent
+                           requestTimeout:requestTimeout
+                            callbackQueue:nil];
+}
+
+- (id)initWithResponseCallback:(id<ALTResponseCallback>)responseCallback
+                   urlStrategy:(ALTUrlStrategy *)urlStrategy
+                     userAgent:(NSString *)userAgent
+                requestTimeout:(double)requestTimeout
+                 callbackQueue:(dispatch_queue_t)callbackQueue
 {
     self = [super init];
     
@@ -47,6 +70,13 @@ static NSString * const ALTMethodPOST = @"MethodPOST";
     self.logger = ALTAlltrackFactory.logger;
     self.defaultSessionConfiguration = [NSURLSessionConfiguration defaultSessionConfiguration];
 
+    // let NSURLSession call back straight into the owner queue instead of hopping there afterwards
+    if (callbackQueue != nil) {
+        self.delegateQueue = [[NSOperationQueue alloc] init];
+        self.delegateQueue.maxConcurrentOperationCount = 1;
+        self.delegateQueue.underlyingQueue = callbackQueue;
+    }
+
     self.exceptionKeys =
         [NSHashTable hashTableWithOptions:NSHashTableStrongMemory];
     [self.exceptionKeys addObject:@"event_callback_id"];
@@ -57,6 +87,9 @@ static NSString * const ALTMethodPOST = @"MethodPOST";
     [self.exceptionKeys addObject:@"algorithm"];
     [self.exceptionKeys addObject:@"app_secret"];
 
+    self.entityTags = [NSMutableDictionary dictionary];
+    self.validatedResponses = [NSMutableDictionary dictionary];
+
     return self;
 }
 
@@ -121,6 +154,16 @@ static NSString * const ALTMethodPOST = @"MethodPOST";
                      urlHostString:urlHostString
                  sendingParameters:sendingParameters];
 
+    if (self.revalidatesGetResponses) {
+        NSString *entityTag;
+        @synchronized (self.entityTags) {
+            entityTag = [self.entityTags objectForKey:path];
+        }
+        if (entityTag != nil) {
+            [urlRequest setValue:entityTag forHTTPHeaderField:@"If-None-Match"];
+        }
+    }
+
     [self sendRequest:urlRequest
      authorizationHeader:authorizationHeader
          responseData:responseData
@@ -160,7 +203,9 @@ authorizationHeader:(NSString *)authorizationHeader
 
 {
     NSURLSession *session =
-        [NSURLSession sessionWithConfiguration:self.defaultSessionConfiguration];
+        [NSURLSession sessionWithConfiguration:self.defaultSessionConfiguration
+                                      delegate:nil
+                                 delegateQueue:self.delegateQueue];
 
     NSURLSessionDataTask *task =
         [session dataTaskWithRequest:request
@@ -171,6 +216,7 @@ authorizationHeader:(NSString *)authorizationHeader
                                 response:(NSHTTPURLResponse *)response
                                    error:error
                             responseData:responseData];
+            [responseData markStage:ALTResponseStageReceived];
             if (responseData.jsonResponse != nil) {
                 [self.logger debug:@"Request succeeded with current URL strategy"];
                 [self.urlStrategy resetAfterSuccess];
@@ -247,6 +293,7 @@ authorizationHeader:(NSString *)authorizationHeader
                                 response:(NSHTTPURLResponse *)response
                                    error:error
                             responseData:responseData];
+            [responseData markStage:ALTResponseStageReceived];
 
             if (responseData.jsonResponse != nil) {
                 [self.logger debug:@"succeeded with current url strategy"];
@@ -304,9 +351,31 @@ authorizationHeader:(NSString *)authorizationHeader
         return;
     }
 
-    [self saveJsonResponse:data responseData:responseData];
-    if (responseData.jsonResponse == nil) {
-        return;
+    NSString *path = responseData.sdkPackage.path;
+    if (statusCode == 304) {
+        // nothing to parse, the response last validated still holds
+        NSDictionary *validatedResponse = nil;
+        if (path != nil) {
+            @synchronized (self.entityTags) {
+                validatedResponse = [self.validatedResponses objectForKey:path];
+            }
+        }
+        if (validatedResponse == nil) {
+            responseData.message = @"Not modified response without a previous one";
+            return;
+        }
+        responseData.jsonResponse = validatedResponse;
+        responseData.notModified = YES;
+    } else {
+        [self saveJsonResponse:data responseData:responseData];
+        if (responseData.jsonResponse == nil) {
+            return;
+        }
+        if (statusCode == 200 && self.revalidatesGetResponses && path != nil) {
+            [self storeEntityTag:[self headerField:@"ETag" ofResponse:urlResponse]
+                        response:responseData.jsonResponse
+                         forPath:path];
+        }
     }
 
     NSString *messageResponse = [responseData.jsonResponse objectForKey:@"message"];
@@ -321,10 +390,36 @@ authorizationHeader:(NSString *)authorizationHeader
         }
     }
 
-    if (statusCode == 200) {
+    if (statusCode == 200 || responseData.notModified) {
         responseData.success = YES;
     }
 }
+
+- (void)storeEntityTag:(NSString *)entityTag
+              response:(NSDictionary *)jsonResponse
+               forPath:(NSString *)path {
+    @synchronized (self.entityTags) {
+        if (entityTag == nil) {
+            // a response without one can't be revalidated, nor can anything before it
+            [self.entityTags removeObjectForKey:path];
+            [self.validatedResponses removeObjectForKey:path];
+            return;
+        }
+        [self.entityTags setObject:entityTag forKey:path];
+        [self.validatedResponses setObject:jsonResponse forKey:path];
+    }
+}
+
+// header names are case insensitive, allHeaderFields keeps them as received
+- (NSString *)headerField:(NSString *)field ofResponse:(NSHTTPURLResponse *)urlResponse {
+    for (id name in urlResponse.allHeaderFields) {
+        if ([name isKindOfClass:[NSString class]] && [name caseInsensitiveCompare:field] == NSOrderedSame) {
+            id value = [urlResponse.allHeaderFields objectForKey:name];
+            return [value isKindOfClass:[NSString class]] ? value : nil;
+        }
+    }
+    return nil;
+}
 #pragma mark - URL Request
 - (NSMutableURLRequest *)
     requestForPostPackage:(NSString *)path
@@ -359,6 +454,15 @@ authorizationHeader:(NSString *)authorizationHeader
 
     NSString *bodyString = [kvParameters componentsJoinedByString:@"&"];
     NSData *body = [NSData dataWithBytes:bodyString.UTF8String length:bodyString.length];
+    if (self.compressesRequestBodies && body.length >= kBodyCompressionThreshold) {
+        NSData *compressedBody = [self gzipData:body];
+        if (compressedBody != nil && compressedBody.length < body.length) {
+            [self.logger verbose:@"Compressed request body from %lu to %lu bytes",
+             (unsigned long)body.length, (unsigned long)compressedBody.length];
+            [request setValue:@"gzip" forHTTPHeaderField:@"Content-Encoding"];
+            body = compressedBody;
+        }
+    }
     [request setHTTPBody:body];
     return request;
 }
@@ -400,6 +504,35 @@ authorizationHeader:(NSString *)authorizationHeader
     return request;
 }
 
+- (NSData *)gzipData:(NSData *)data {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    // 16 added to the window bits asks for the gzip wrapper
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return nil;
+    }
+    stream.next_in = (Bytef *)data.bytes;
+    stream.avail_in = (uInt)data.length;
+
+    // the url encoded input usually shrinks a lot, start small and grow in chunks
+    NSMutableData *compressed = [NSMutableData dataWithLength:MIN(data.length, kBodyCompressionChunkSize)];
+    int status = Z_OK;
+    while (status == Z_OK) {
+        if (stream.total_out >= compressed.length) {
+            [compressed increaseLengthBy:kBodyCompressionChunkSize];
+        }
+        stream.next_out = (Bytef *)compressed.mutableBytes + stream.total_out;
+        stream.avail_out = (uInt)(compressed.length - stream.total_out);
+        status = deflate(&stream, Z_FINISH);
+    }
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        return nil;
+    }
+    [compressed setLength:stream.total_out];
+    return compressed;
+}
+
 - (void)
     injectParameters:(NSDictionary<NSString *, NSString *> *)parameters
     kvArray:(NSMutableArray<NSString *> *)kvArray
@@ -11,6 +11,18 @@ typedef NS_ENUM(int, ALTTrackingState) {
     ALTTrackingStateOptedOut = 1
 };
 
+typedef NS_ENUM(NSUInteger, ALTResponseStage) {
+    // response received by the request handler
+    ALTResponseStageReceived = 0,
+    // response processed by the handler that sent the package
+    ALTResponseStageHandler,
+    // attribution information checked by the attribution handler
+    ALTResponseStageAttribution,
+    // response tasks started by the activity handler
+    ALTResponseStageActivity,
+    ALTResponseStageCount
+};
+
 @interface ALTResponseData : NSObject <NSCopying>
 
 @property (nonatomic, assign) ALTActivityKind activityKind;
@@ -25,6 +37,9 @@ typedef NS_ENUM(int, ALTTrackingState) {
 
 @property (nonatomic, assign) BOOL willRetry;
 
+// Answered with 304, the json response is the last one received for the same path.
+@property (nonatomic, assign) BOOL notModified;
+
 @property (nonatomic, assign) ALTTrackingState trackingState;
 
 @property (nonatomic, strong) NSDictionary *jsonResponse;
@@ -39,6 +54,12 @@ typedef NS_ENUM(int, ALTTrackingState) {
 
 + (id)buildResponseData:(ALTActivityPackage *)activityPackage;
 
+- (void)markStage:(ALTResponseStage)stage;
+
+// Seconds elapsed between two marked stages, -1 if any of them was not reached.
+- (NSTimeInterval)secondsFromStage:(ALTResponseStage)fromStage
+                           toStage:(ALTResponseStage)toStage;
+
 @end
 
 @interface ALTSessionResponseData : ALTResponseData
@@ -1,5 +1,12 @@
 #import "ALTResponseData.h"
 #import "ALTActivityKind.h"
+#import "ALTExecutor.h"
+
+@interface ALTResponseData() {
+    uint64_t _stageTimestamps[ALTResponseStageCount];
+}
+
+@end
 
 @implementation ALTResponseData
 
@@ -60,6 +67,26 @@
     return responseData;
 }
 
+- (void)markStage:(ALTResponseStage)stage {
+    if (stage >= ALTResponseStageCount) {
+        return;
+    }
+    _stageTimestamps[stage] = [ALTExecutor timestamp];
+}
+
+- (NSTimeInterval)secondsFromStage:(ALTResponseStage)fromStage
+                           toStage:(ALTResponseStage)toStage {
+    if (fromStage >= ALTResponseStageCount || toStage >= ALTResponseStageCount) {
+        return -1;
+    }
+    uint64_t from = _stageTimestamps[fromStage];
+    uint64_t to = _stageTimestamps[toStage];
+    if (from == 0 || to == 0 || to < from) {
+        return -1;
+    }
+    return [ALTExecutor secondsFromTimestamp:from toTimestamp:to];
+}
+
 - (NSString *)description {
     return [NSString stringWithFormat:@"message:%@ timestamp:%@ adid:%@ success:%d willRetry:%d attribution:%@ trackingState:%d, json:%@",
             self.message, self.timeStamp, self.adid, self.success, self.willRetry, self.attribution, self.trackingState, self.jsonResponse];
@@ -78,6 +105,7 @@
         copy.trackingState = self.trackingState;
         copy.jsonResponse = [self.jsonResponse copyWithZone:zone];
         copy.attribution = [self.attribution copyWithZone:zone];
+        memcpy(copy->_stageTimestamps, _stageTimestamps, sizeof(_stageTimestamps));
     }
 
     return copy;
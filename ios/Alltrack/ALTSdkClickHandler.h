@@ -15,4 +15,6 @@
 - (void)sendSdkClick:(ALTActivityPackage *)sdkClickPackage;
 - (void)teardown;
 
++ (void)deleteState;
+
 @end
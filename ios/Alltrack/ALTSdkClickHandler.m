@@ -1,16 +1,27 @@
 #import "ALTUtil.h"
+#import "ALTExecutor.h"
+#import "ALTTimerWheel.h"
 #import "ALTLogger.h"
 #import "ALTAlltrackFactory.h"
 #import "ALTSdkClickHandler.h"
 #import "ALTBackoffStrategy.h"
 #import "ALTUserDefaults.h"
 #import "ALTPackageBuilder.h"
+#import "ALTAdServicesTokenCache.h"
+#import "ALTPackageQueueFile.h"
+#import "ALTStorageWriter.h"
 
-static const char * const kInternalQueueName = "com.alltrack.SdkClickQueue";
+static NSString   * const kSdkClickQueueFilename = @"AlltrackIoSdkClickQueue";
+static const char * const kInternalQueueName     = "com.alltrack.SdkClickQueue";
+// how long an AdServices click waits for a fresh token before it goes with its stored one
+static const NSTimeInterval kAdServicesTokenTimeout = 3;
 
 @interface ALTSdkClickHandler()
 
 @property (nonatomic, strong) NSMutableArray *packageQueue;
+// sent and waiting for their response, still stored in case the app is killed meanwhile
+@property (nonatomic, strong) NSMutableArray *sentPackages;
+@property (nonatomic, strong) ALTPackageQueueFile *packageQueueFile;
 @property (nonatomic, strong) dispatch_queue_t internalQueue;
 @property (nonatomic, strong) ALTRequestHandler *requestHandler;
 
@@ -20,8 +31,6 @@ static const char * const kInternalQueueName = "com.alltrack.SdkClickQueue";
 @property (nonatomic, weak) id<ALTLogger> logger;
 @property (nonatomic, weak) id<ALTActivityHandler> activityHandler;
 
-@property (nonatomic, assign) NSInteger lastPackageRetriesCount;
-
 @end
 
 @implementation ALTSdkClickHandler
@@ -38,15 +47,16 @@ static const char * const kInternalQueueName = "com.alltrack.SdkClickQueue";
         return nil;
     }
 
-    self.internalQueue = dispatch_queue_create(kInternalQueueName, DISPATCH_QUEUE_SERIAL);
+    self.internalQueue = [ALTExecutor mailboxWithName:kInternalQueueName
+                                             priority:ALTExecutorPriorityLow];
     self.logger = ALTAlltrackFactory.logger;
-    self.lastPackageRetriesCount = 0;
 
     self.requestHandler = [[ALTRequestHandler alloc]
                            initWithResponseCallback:self
                            urlStrategy:urlStrategy
                            userAgent:userAgent
-                           requestTimeout:[ALTAlltrackFactory requestTimeout]];
+                           requestTimeout:[ALTAlltrackFactory requestTimeout]
+                           callbackQueue:self.internalQueue];
 
     [ALTUtil launchInQueue:self.internalQueue
                 selfInject:self
@@ -68,11 +78,11 @@ static const char * const kInternalQueueName = "com.alltrack.SdkClickQueue";
 }
 
 - (void)sendSdkClick:(ALTActivityPackage *)sdkClickPackage {
-    [ALTUtil launchInQueue:self.internalQueue
-                selfInject:self
-                     block:^(ALTSdkClickHandler *selfI) {
-                         [selfI sendSdkClickI:selfI sdkClickPackage:sdkClickPackage];
-                     }];
+    [ALTUtil launchInOwnQueue:self.internalQueue
+                   selfInject:self
+                        block:^(ALTSdkClickHandler *selfI) {
+                            [selfI sendSdkClickI:selfI sdkClickPackage:sdkClickPackage];
+                        }];
 }
 
 - (void)sendNextSdkClick {
@@ -94,9 +104,16 @@ static const char * const kInternalQueueName = "com.alltrack.SdkClickQueue";
     self.logger = nil;
     self.backoffStrategy = nil;
     self.packageQueue = nil;
+    self.sentPackages = nil;
     self.activityHandler = nil;
 }
 
++ (void)deleteState {
+    // a write still in flight would bring the file back
+    [[ALTStorageWriter sharedWriter] flush];
+    [ALTUtil deleteFileWithName:kSdkClickQueueFilename];
+}
+
 #pragma mark - Private & helper methods
 
 -   (void)initI:(ALTSdkClickHandler *)selfI
@@ -105,12 +122,22 @@ activityHandler:(id<ALTActivityHandler>)activityHandler
     selfI.activityHandler = activityHandler;
     selfI.paused = !startsSending;
     selfI.backoffStrategy = [ALTAlltrackFactory sdkClickHandlerBackoffStrategy];
-    selfI.packageQueue = [NSMutableArray array];
+    selfI.sentPackages = [NSMutableArray array];
+    selfI.packageQueueFile = [ALTPackageQueueFile queueFileWithName:kSdkClickQueueFilename
+                                                         objectName:@"Sdk click queue"];
+    [selfI readPackageQueueI:selfI];
+    [selfI sendNextSdkClick];
 }
 
 - (void)sendSdkClickI:(ALTSdkClickHandler *)selfI
       sdkClickPackage:(ALTActivityPackage *)sdkClickPackage {
+    if ([ALTPackageBuilder isAdServicesPackage:sdkClickPackage]) {
+        // fetched while the click waits, so a fresh token is at hand when it goes out
+        [[ALTAdServicesTokenCache sharedCache] prefetch];
+    }
+    [selfI removeSupersededClicksI:selfI sdkClickPackage:sdkClickPackage];
     [selfI.packageQueue addObject:sdkClickPackage];
+    [selfI writePackageQueueI:selfI];
     [selfI.logger debug:@"Added sdk_click %d", selfI.packageQueue.count];
     [selfI.logger verbose:@"%@", sdkClickPackage.extendedString];
     [selfI sendNextSdkClick];
@@ -129,32 +156,79 @@ activityHandler:(id<ALTActivityHandler>)activityHandler
         return;
     }
 
-    ALTActivityPackage *sdkClickPackage = [self.packageQueue objectAtIndex:0];
-    [self.packageQueue removeObjectAtIndex:0];
+    ALTActivityPackage *sdkClickPackage = [selfI.packageQueue objectAtIndex:0];
+    [selfI.packageQueue removeObjectAtIndex:0];
 
     if (![sdkClickPackage isKindOfClass:[ALTActivityPackage class]]) {
         [selfI.logger error:@"Failed to read sdk_click package"];
+        [selfI writePackageQueueI:selfI];
         [selfI sendNextSdkClick];
         return;
     }
-    
+    // the stored queue is the sent packages followed by the queued ones, moving it keeps the order
+    [selfI.sentPackages addObject:sdkClickPackage];
+
     if ([ALTPackageBuilder isAdServicesPackage:sdkClickPackage]) {
-        // refresh token
-        NSString *token = [ALTUtil fetchAdServicesAttribution:nil];
-        
-        if (token != nil && ![sdkClickPackage.parameters[ALTAttributionTokenParameter] isEqualToString:token]) {
-            // update token
-            [ALTPackageBuilder parameters:sdkClickPackage.parameters
-                                setString:token
-                                   forKey:ALTAttributionTokenParameter];
-            
-            // update created_at
-            [ALTPackageBuilder parameters:sdkClickPackage.parameters
-                              setDate1970:[NSDate.date timeIntervalSince1970]
-                                   forKey:@"created_at"];
+        NSString *token = [[ALTAdServicesTokenCache sharedCache] cachedToken];
+        if (token == nil) {
+            // e.g. a click restored after a restart, its stored token may have gone stale
+            [selfI waitForAdServicesTokenI:selfI sdkClickPackage:sdkClickPackage];
+            return;
+        }
+        [selfI updateAdServicesTokenI:selfI sdkClickPackage:sdkClickPackage token:token];
+    }
+
+    [selfI sendPackageI:selfI sdkClickPackage:sdkClickPackage];
+}
+
+- (void)waitForAdServicesTokenI:(ALTSdkClickHandler *)selfI
+                sdkClickPackage:(ALTActivityPackage *)sdkClickPackage {
+    // whichever comes first of the fetch and the timeout sends the click, only on the internal queue
+    __block BOOL proceeded = NO;
+    void (^proceed)(NSString *) = ^(NSString *token) {
+        if (proceeded) {
+            return;
         }
+        proceeded = YES;
+        if (token != nil) {
+            [selfI updateAdServicesTokenI:selfI sdkClickPackage:sdkClickPackage token:token];
+        } else {
+            [selfI.logger debug:@"No fresh AdServices token, sending sdk_click with the stored one"];
+        }
+        [selfI sendPackageI:selfI sdkClickPackage:sdkClickPackage];
+    };
+
+    dispatch_queue_t internalQueue = selfI.internalQueue;
+    [[ALTAdServicesTokenCache sharedCache] tokenWithCompletion:^(NSString *token, NSError *error) {
+        dispatch_async(internalQueue, ^{
+            proceed(token);
+        });
+    }];
+    [[ALTTimerWheel sharedWheel] scheduleBlock:^{ proceed(nil); }
+                                         queue:internalQueue
+                                         after:kAdServicesTokenTimeout];
+}
+
+- (void)updateAdServicesTokenI:(ALTSdkClickHandler *)selfI
+               sdkClickPackage:(ALTActivityPackage *)sdkClickPackage
+                         token:(NSString *)token {
+    if ([sdkClickPackage.parameters[ALTAttributionTokenParameter] isEqualToString:token]) {
+        return;
     }
+    // update token
+    [ALTPackageBuilder parameters:sdkClickPackage.parameters
+                        setString:token
+                           forKey:ALTAttributionTokenParameter];
+
+    // update created_at
+    [ALTPackageBuilder parameters:sdkClickPackage.parameters
+                      setDate1970:[NSDate.date timeIntervalSince1970]
+                           forKey:@"created_at"];
+    [selfI.packageQueueFile discardRecordOfPackage:sdkClickPackage];
+}
 
+- (void)sendPackageI:(ALTSdkClickHandler *)selfI
+     sdkClickPackage:(ALTActivityPackage *)sdkClickPackage {
     dispatch_block_t work = ^{
         NSDictionary *sendingParameters = @{
             @"sent_at": [ALTUtil formatSeconds1970:[NSDate.date timeIntervalSince1970]]
@@ -166,19 +240,85 @@ activityHandler:(id<ALTActivityHandler>)activityHandler
         [selfI sendNextSdkClick];
     };
 
-    if (selfI.lastPackageRetriesCount <= 0) {
+    if (sdkClickPackage.retries <= 0) {
         work();
         return;
     }
 
-    NSTimeInterval waitTime = [ALTUtil waitingTime:selfI.lastPackageRetriesCount backoffStrategy:self.backoffStrategy];
+    NSTimeInterval waitTime = [ALTUtil waitingTime:sdkClickPackage.retries backoffStrategy:selfI.backoffStrategy];
     NSString *waitTimeFormatted = [ALTUtil secondsNumberFormat:waitTime];
 
-    [self.logger verbose:@"Waiting for %@ seconds before retrying sdk_click for the %d time", waitTimeFormatted, selfI.lastPackageRetriesCount];
-    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(waitTime * NSEC_PER_SEC)), self.internalQueue, work);
+    [selfI.logger verbose:@"Waiting for %@ seconds before retrying sdk_click for the %d time", waitTimeFormatted, sdkClickPackage.retries];
+    [[ALTTimerWheel sharedWheel] scheduleBlock:work queue:selfI.internalQueue after:waitTime];
+}
+
+// A newer attribution token click makes the queued ones from the same source redundant,
+// only the latest one is sent. Clicks already sent are left to their response.
+- (void)removeSupersededClicksI:(ALTSdkClickHandler *)selfI
+                sdkClickPackage:(ALTActivityPackage *)sdkClickPackage {
+    NSString *source = [ALTSdkClickHandler attributionSourceOfPackage:sdkClickPackage];
+    if (source == nil) {
+        return;
+    }
+    NSIndexSet *superseded = [selfI.packageQueue indexesOfObjectsPassingTest:^BOOL(id package, NSUInteger idx, BOOL *stop) {
+        return [package isKindOfClass:[ALTActivityPackage class]]
+            && [source isEqualToString:[ALTSdkClickHandler attributionSourceOfPackage:package]];
+    }];
+    if (superseded.count == 0) {
+        return;
+    }
+    [selfI.packageQueue removeObjectsAtIndexes:superseded];
+    [selfI.logger debug:@"Coalesced %d queued %@ sdk_click packages", superseded.count, source];
+}
+
++ (NSString *)attributionSourceOfPackage:(ALTActivityPackage *)sdkClickPackage {
+    if ([ALTPackageBuilder isAdServicesPackage:sdkClickPackage]) {
+        return ALTAdServicesPackageKey;
+    }
+    if ([sdkClickPackage.parameters.allValues containsObject:ALTiAdPackageKey]) {
+        return ALTiAdPackageKey;
+    }
+    return nil;
+}
+
+- (void)readPackageQueueI:(ALTSdkClickHandler *)selfI {
+    // the previous instance may not be done writing yet
+    [[ALTStorageWriter sharedWriter] flush];
+
+    NSMutableArray *packages = [selfI.packageQueueFile readPackages];
+    if (packages != nil) {
+        // whatever was in flight when the app stopped is sent again, with the retries it had
+        [selfI.logger debug:@"Sdk click handler read %d packages", packages.count];
+        selfI.packageQueue = packages;
+    } else {
+        selfI.packageQueue = [NSMutableArray array];
+    }
+}
+
+- (void)writePackageQueueI:(ALTSdkClickHandler *)selfI {
+#if TARGET_OS_TV
+    return;
+#endif
+    if (selfI.packageQueue == nil || selfI.sentPackages == nil) {
+        return;
+    }
+    NSArray *packages = [selfI.sentPackages arrayByAddingObjectsFromArray:selfI.packageQueue];
+    // only packages not written before are archived here, the file is written on the storage queue
+    NSUInteger count = packages.count;
+    id<ALTLogger> logger = selfI.logger;
+    [selfI.packageQueueFile writePackages:packages
+                               completion:^(BOOL written) {
+                                   if (written) {
+                                       [logger verbose:@"Sdk click handler wrote %d packages", count];
+                                   }
+                               }];
 }
 
 - (void)responseCallback:(ALTResponseData *)responseData {
+    [responseData markStage:ALTResponseStageHandler];
+    // called on the internal queue
+    ALTActivityPackage *sdkClickPackage = responseData.sdkClickPackage;
+    [self.sentPackages removeObjectIdenticalTo:sdkClickPackage];
     if (responseData.jsonResponse) {
         [self.logger debug:
             @"Got click JSON response with message: %@", responseData.message];
@@ -189,17 +329,21 @@ activityHandler:(id<ALTActivityHandler>)activityHandler
     // Check if any package response contains information that user has opted out.
     // If yes, disable SDK and flush any potentially stored packages that happened afterwards.
     if (responseData.trackingState == ALTTrackingStateOptedOut) {
-        self.lastPackageRetriesCount = 0;
+        [self writePackageQueueI:self];
         [self.activityHandler setTrackingStateOptedOut];
         return;
     }
     if (responseData.jsonResponse == nil) {
-        self.lastPackageRetriesCount++;
-        [self.logger error:@"Retrying sdk_click package for the %d time", self.lastPackageRetriesCount];
-        [self sendSdkClick:responseData.sdkClickPackage];
+        // retried ahead of the queue with its own count, which is stored with it
+        sdkClickPackage.retries++;
+        [self.packageQueueFile discardRecordOfPackage:sdkClickPackage];
+        [self.packageQueue insertObject:sdkClickPackage atIndex:0];
+        [self writePackageQueueI:self];
+        [self.logger error:@"Retrying sdk_click package for the %d time", sdkClickPackage.retries];
+        [self sendNextSdkClick];
         return;
     }
-    self.lastPackageRetriesCount = 0;
+    [self writePackageQueueI:self];
     
     if ([responseData.sdkClickPackage.parameters.allValues containsObject:ALTiAdPackageKey]) {
         // received iAd click package response, clear the errors from UserDefaults
@@ -0,0 +1,29 @@
+#import <Foundation/Foundation.h>
+
+#import "ALTAttribution.h"
+
+// Immutable copy of the state read by the public getters.
+@interface ALTStateSnapshot : NSObject
+
+@property (nonatomic, copy, readonly) NSString *adid;
+@property (nonatomic, copy, readonly) ALTAttribution *attribution;
+@property (nonatomic, assign, readonly) BOOL enabled;
+@property (nonatomic, assign, readonly) BOOL isGdprForgotten;
+
+- (id)initWithAdid:(NSString *)adid
+       attribution:(ALTAttribution *)attribution
+           enabled:(BOOL)enabled
+   isGdprForgotten:(BOOL)isGdprForgotten;
+
+@end
+
+// Holds the latest snapshot. Readers take no lock, they load and retain the published
+// snapshot while counted as readers. A replaced snapshot is released on a later publish,
+// once no reader that could still be loading it is left.
+@interface ALTStateSnapshotCell : NSObject
+
+- (void)publish:(ALTStateSnapshot *)snapshot;
+
+- (ALTStateSnapshot *)current;
+
+@end
@@ -0,0 +1,109 @@
+#include <stdatomic.h>
+#include <pthread.h>
+
+#import "ALTStateSnapshot.h"
+
+@implementation ALTStateSnapshot
+
+- (id)initWithAdid:(NSString *)adid
+       attribution:(ALTAttribution *)attribution
+           enabled:(BOOL)enabled
+   isGdprForgotten:(BOOL)isGdprForgotten
+{
+    self = [super init];
+    if (self == nil) return nil;
+
+    _adid = [adid copy];
+    _attribution = [attribution copy];
+    _enabled = enabled;
+    _isGdprForgotten = isGdprForgotten;
+
+    return self;
+}
+
+@end
+
+#pragma mark - private
+@interface ALTStateSnapshotCell() {
+    _Atomic(void *) _current;
+    // readers count themselves in the slot of the epoch they entered in, so after a publish
+    // flips the epoch, the slot of the earlier readers drains even under constant reads
+    atomic_uint _epoch;
+    atomic_uint _readers[2];
+    // publisher side only
+    pthread_mutex_t _publishLock;
+    NSMutableArray *_retired;
+    // per retired snapshot, which reader slots were seen empty since it was replaced
+    NSMutableArray *_retiredSeenEmpty;
+}
+
+@end
+
+#pragma mark -
+@implementation ALTStateSnapshotCell
+
+- (id)init {
+    self = [super init];
+    if (self == nil) return nil;
+
+    atomic_init(&_current, NULL);
+    atomic_init(&_epoch, 0);
+    atomic_init(&_readers[0], 0);
+    atomic_init(&_readers[1], 0);
+    pthread_mutex_init(&_publishLock, NULL);
+    _retired = [NSMutableArray array];
+    _retiredSeenEmpty = [NSMutableArray array];
+
+    return self;
+}
+
+- (void)publish:(ALTStateSnapshot *)snapshot {
+    pthread_mutex_lock(&_publishLock);
+
+    void *replaced = atomic_exchange(&_current, (__bridge_retained void *)snapshot);
+    atomic_fetch_add(&_epoch, 1);
+    if (replaced != NULL) {
+        [_retired addObject:(__bridge_transfer ALTStateSnapshot *)replaced];
+        [_retiredSeenEmpty addObject:@0];
+    }
+
+    // a reader that loaded a replaced snapshot was counted before the exchange above, once
+    // each slot was seen empty after it, that reader is gone
+    NSUInteger emptySlots = 0;
+    for (NSUInteger slot = 0; slot < 2; slot++) {
+        if (atomic_load(&_readers[slot]) == 0) {
+            emptySlots |= 1 << slot;
+        }
+    }
+    for (NSUInteger i = _retired.count; i > 0; i--) {
+        NSUInteger seenEmpty = [_retiredSeenEmpty[i - 1] unsignedIntegerValue] | emptySlots;
+        if (seenEmpty == 3) {
+            [_retired removeObjectAtIndex:i - 1];
+            [_retiredSeenEmpty removeObjectAtIndex:i - 1];
+        } else {
+            _retiredSeenEmpty[i - 1] = @(seenEmpty);
+        }
+    }
+
+    pthread_mutex_unlock(&_publishLock);
+}
+
+- (ALTStateSnapshot *)current {
+    atomic_uint *readers = &_readers[atomic_load(&_epoch) & 1];
+    atomic_fetch_add(readers, 1);
+    void *current = atomic_load(&_current);
+    // retained while still counted, a publish can't release it from under the reader
+    ALTStateSnapshot *snapshot = current != NULL ? CFBridgingRelease(CFRetain(current)) : nil;
+    atomic_fetch_sub_explicit(readers, 1, memory_order_release);
+    return snapshot;
+}
+
+- (void)dealloc {
+    void *current = atomic_load(&_current);
+    if (current != NULL) {
+        CFRelease(current);
+    }
+    pthread_mutex_destroy(&_publishLock);
+}
+
+@end
@@ -0,0 +1,41 @@
+#import <Foundation/Foundation.h>
+
+@interface ALTStateStoreTransaction : NSObject
+
+- (void)setObject:(id)object forKey:(NSString *)key;
+
+- (void)removeObjectForKey:(NSString *)key;
+
+@end
+
+// Single file holding the local state that used to live in one archive file per object.
+// The file is opened and read once. Each transaction is applied in memory right away and
+// appended as one checksummed batch by the storage writer, which syncs all batches committed
+// within its commit window with a single flush. A torn batch at the end of the file is
+// dropped on the next open. Superseded batches are compacted away once they take up most
+// of the file.
+@interface ALTStateStore : NSObject
+
++ (ALTStateStore *)sharedStore;
+
+// Falls back to the legacy archive file with the same name for as long as it exists,
+// and moves what it finds into the store. The file is deleted once the move is on disk.
+- (id)objectForKey:(NSString *)key
+             class:(Class)classToRead
+        objectName:(NSString *)objectName
+        syncObject:(id)syncObject;
+
+- (void)setObject:(id)object
+           forKey:(NSString *)key
+       objectName:(NSString *)objectName;
+
+- (void)removeObjectForKey:(NSString *)key;
+
+// Everything changed in the block is committed as one batch. Returns NO if it couldn't be encoded.
+- (BOOL)performTransaction:(void (^)(ALTStateStoreTransaction *transaction))block;
+
+// The completion is called on the storage queue once the batch is on disk, or failed to get there.
+- (BOOL)performTransaction:(void (^)(ALTStateStoreTransaction *transaction))block
+                completion:(void (^)(BOOL written))completion;
+
+@end
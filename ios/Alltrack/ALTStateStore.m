@@ -0,0 +1,465 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#import "ALTStateStore.h"
+#import "ALTAlltrackFactory.h"
+#import "ALTStorageWriter.h"
+#import "ALTUtil.h"
+
+static NSString * const kStoreFilename = @"AlltrackIoState";
+static NSString * const kBatchSetKey = @"set";
+static NSString * const kBatchRemoveKey = @"remove";
+static const uint32_t kBatchMagic = 0x414c5442; // "ALTB"
+// smaller files are never worth compacting
+static const unsigned long long kCompactionMinSize = 64 * 1024;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t length;
+    uint32_t checksum;
+} ALTStateStoreBatchHeader;
+
+static ALTStateStore *sharedStore = nil;
+
+static uint32_t batchChecksum(const void *bytes, size_t length) {
+    // FNV-1a
+    const uint8_t *data = (const uint8_t *)bytes;
+    uint32_t hash = 0x811c9dc5;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+#pragma mark - transaction
+@interface ALTStateStoreTransaction()
+
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSData *> *sets;
+@property (nonatomic, strong) NSMutableSet<NSString *> *removals;
+
+@end
+
+@implementation ALTStateStoreTransaction
+
+- (id)init {
+    self = [super init];
+    if (self == nil) return nil;
+
+    self.sets = [NSMutableDictionary dictionary];
+    self.removals = [NSMutableSet set];
+
+    return self;
+}
+
+- (void)setObject:(id)object forKey:(NSString *)key {
+    if (key == nil) {
+        return;
+    }
+    if (object == nil) {
+        [self removeObjectForKey:key];
+        return;
+    }
+    NSData *data = [ALTUtil archiveObject:object];
+    if (data == nil) {
+        [[ALTAlltrackFactory logger] error:@"Failed to archive %@ for the state store", key];
+        return;
+    }
+    [self.removals removeObject:key];
+    [self.sets setObject:data forKey:key];
+}
+
+- (void)removeObjectForKey:(NSString *)key {
+    if (key == nil) {
+        return;
+    }
+    [self.sets removeObjectForKey:key];
+    [self.removals addObject:key];
+}
+
+- (BOOL)isEmpty {
+    return self.sets.count == 0 && self.removals.count == 0;
+}
+
+@end
+
+#pragma mark - private
+@interface ALTStateStore()
+
+@property (nonatomic, copy) NSString *filePath;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, NSData *> *values;
+@property (nonatomic, assign) int fileDescriptor;
+@property (nonatomic, assign) unsigned long long fileSize;
+@property (nonatomic, assign) unsigned long long liveSize;
+// applied to the values already, waiting for the storage writer
+@property (nonatomic, strong) NSMutableArray<NSData *> *pendingRecords;
+// changed through the store since launch, a legacy file still around for them is stale
+@property (nonatomic, strong) NSMutableSet<NSString *> *storedKeys;
+
+@end
+
+#pragma mark -
+@implementation ALTStateStore
+
++ (ALTStateStore *)sharedStore {
+    @synchronized (self) {
+        if (sharedStore == nil) {
+            sharedStore = [[ALTStateStore alloc] init];
+        }
+        return sharedStore;
+    }
+}
+
+- (id)init {
+    self = [super init];
+    if (self == nil) return nil;
+
+    self.filePath = [ALTUtil getFilePathInAppSupportDir:kStoreFilename];
+    self.values = [NSMutableDictionary dictionary];
+    self.fileDescriptor = -1;
+    self.fileSize = 0;
+    self.liveSize = 0;
+    self.pendingRecords = [NSMutableArray array];
+    self.storedKeys = [NSMutableSet set];
+
+    [self load];
+
+    return self;
+}
+
+- (id)objectForKey:(NSString *)key
+             class:(Class)classToRead
+        objectName:(NSString *)objectName
+        syncObject:(id)syncObject {
+#if TARGET_OS_TV
+    return nil;
+#endif
+    NSData *data;
+    BOOL stored;
+    @synchronized (self) {
+        data = [self.values objectForKey:key];
+        stored = [self.storedKeys containsObject:key];
+    }
+
+    if (data != nil) {
+        id object = [ALTUtil unarchiveData:data class:classToRead];
+        if (object == nil) {
+            [[ALTAlltrackFactory logger] error:@"Failed to read %@ from the state store", objectName];
+        } else {
+            [[ALTAlltrackFactory logger] debug:@"Read %@: %@", objectName, object];
+        }
+        return object;
+    }
+    // each legacy file is read until its content made it into the store and it was deleted,
+    // whatever happened to the other ones
+    if (stored || ![self hasLegacyFileForKey:key]) {
+        return nil;
+    }
+
+    // outside of the store lock, the legacy read takes the lock of the object
+    id legacyObject = [ALTUtil readObject:key
+                               objectName:objectName
+                                    class:classToRead
+                               syncObject:syncObject];
+    if (legacyObject == nil) {
+        return nil;
+    }
+    [self performTransaction:^(ALTStateStoreTransaction *transaction) {
+        [transaction setObject:legacyObject forKey:key];
+    }
+                  completion:^(BOOL written) {
+        // the legacy file goes away only once its content is safely in the store
+        if (written) {
+            [[ALTAlltrackFactory logger] verbose:@"Moved %@ file into the state store", key];
+            [ALTUtil deleteFileWithName:key];
+        }
+    }];
+    return legacyObject;
+}
+
+- (void)setObject:(id)object
+           forKey:(NSString *)key
+       objectName:(NSString *)objectName {
+    [self performTransaction:^(ALTStateStoreTransaction *transaction) {
+        [transaction setObject:object forKey:key];
+    }
+                  completion:^(BOOL written) {
+        if (written) {
+            [[ALTAlltrackFactory logger] debug:@"Wrote %@: %@", objectName, object];
+        } else {
+            [[ALTAlltrackFactory logger] error:@"Failed to write %@ file", objectName];
+        }
+    }];
+}
+
+- (void)removeObjectForKey:(NSString *)key {
+    [self performTransaction:^(ALTStateStoreTransaction *transaction) {
+        [transaction removeObjectForKey:key];
+    }];
+}
+
+- (BOOL)performTransaction:(void (^)(ALTStateStoreTransaction *transaction))block {
+    return [self performTransaction:block completion:nil];
+}
+
+- (BOOL)performTransaction:(void (^)(ALTStateStoreTransaction *transaction))block
+                completion:(void (^)(BOOL written))completion {
+#if TARGET_OS_TV
+    return NO;
+#endif
+    ALTStateStoreTransaction *transaction = [[ALTStateStoreTransaction alloc] init];
+    if (block != nil) {
+        block(transaction);
+    }
+
+    BOOL hasChanges = NO;
+    NSArray<NSString *> *removedKeys = nil;
+    if (![transaction isEmpty]) {
+        @synchronized (self) {
+            // removing what isn't there doesn't need to hit the disk
+            NSMutableArray *removals = [NSMutableArray array];
+            for (NSString *key in transaction.removals) {
+                if ([self.values objectForKey:key] != nil) {
+                    [removals addObject:key];
+                }
+            }
+
+            if (transaction.sets.count > 0 || removals.count > 0) {
+                NSDictionary *batch = @{kBatchSetKey: transaction.sets,
+                                        kBatchRemoveKey: removals};
+                NSData *record = [self recordWithBatch:batch];
+                if (record == nil) {
+                    return NO;
+                }
+                // readers see the change right away, the disk catches up on the storage queue
+                [self applyBatchI:batch];
+                [self.storedKeys addObjectsFromArray:[transaction.sets allKeys]];
+                [self.storedKeys addObjectsFromArray:removals];
+                [self.pendingRecords addObject:record];
+                hasChanges = YES;
+                removedKeys = removals;
+            }
+        }
+    }
+
+    if (!hasChanges) {
+        if (completion != nil) {
+            completion(YES);
+        }
+        return YES;
+    }
+
+    BOOL (^writeBlock)(void) = ^BOOL{
+        return [self writePendingRecordsI];
+    };
+    void (^writeCompletion)(BOOL) = completion;
+    if (removedKeys.count > 0) {
+        writeCompletion = ^(BOOL written) {
+            // a legacy file left behind by an interrupted move must not bring the value back
+            if (written) {
+                for (NSString *key in removedKeys) {
+                    if ([self hasLegacyFileForKey:key]) {
+                        [ALTUtil deleteFileWithName:key];
+                    }
+                }
+            }
+            if (completion != nil) {
+                completion(written);
+            }
+        };
+    }
+    [[ALTStorageWriter sharedWriter] submitWriteForKey:kStoreFilename
+                                                 block:writeBlock
+                                            completion:writeCompletion];
+    return YES;
+}
+
+- (void)dealloc {
+    if (self.fileDescriptor >= 0) {
+        close(self.fileDescriptor);
+    }
+}
+
+#pragma mark - private
+
+- (void)load {
+    if (self.filePath == nil) {
+        return;
+    }
+    NSData *data = [NSData dataWithContentsOfFile:self.filePath];
+    if (data == nil) {
+        return;
+    }
+
+    const uint8_t *bytes = data.bytes;
+    NSUInteger offset = 0;
+    while (offset + sizeof(ALTStateStoreBatchHeader) <= data.length) {
+        ALTStateStoreBatchHeader header;
+        memcpy(&header, bytes + offset, sizeof(header));
+        NSUInteger payloadOffset = offset + sizeof(header);
+        if (header.magic != kBatchMagic
+            || header.length > data.length - payloadOffset
+            || batchChecksum(bytes + payloadOffset, header.length) != header.checksum)
+        {
+            break;
+        }
+
+        NSData *payload = [data subdataWithRange:NSMakeRange(payloadOffset, header.length)];
+        id batch = [NSPropertyListSerialization propertyListWithData:payload
+                                                             options:NSPropertyListImmutable
+                                                              format:NULL
+                                                               error:nil];
+        if (![batch isKindOfClass:[NSDictionary class]]) {
+            break;
+        }
+        [self applyBatchI:batch];
+        offset = payloadOffset + header.length;
+    }
+
+    if (offset < data.length) {
+        // the last commit didn't make it to the disk completely
+        [[ALTAlltrackFactory logger] warn:@"Dropping %lu bytes of incomplete state store data",
+         (unsigned long)(data.length - offset)];
+        truncate([self.filePath fileSystemRepresentation], (off_t)offset);
+    }
+    self.fileSize = offset;
+}
+
+- (BOOL)hasLegacyFileForKey:(NSString *)key {
+    // legacy files were written to the documents directory before the application support one
+    NSString *appSupportFilePath = [ALTUtil getFilePathInAppSupportDir:key];
+    NSString *documentsFilePath = [ALTUtil getFilePathInDocumentsDir:key];
+    return (appSupportFilePath != nil && access([appSupportFilePath fileSystemRepresentation], F_OK) == 0)
+        || (documentsFilePath != nil && access([documentsFilePath fileSystemRepresentation], F_OK) == 0);
+}
+
+- (NSData *)recordWithBatch:(NSDictionary *)batch {
+    NSError *error = nil;
+    NSData *payload = [NSPropertyListSerialization dataWithPropertyList:batch
+                                                                 format:NSPropertyListBinaryFormat_v1_0
+                                                                options:0
+                                                                  error:&error];
+    if (payload == nil) {
+        [[ALTAlltrackFactory logger] error:@"Failed to encode state store batch (%@)", error.localizedDescription];
+        return nil;
+    }
+
+    ALTStateStoreBatchHeader header;
+    header.magic = kBatchMagic;
+    header.length = (uint32_t)payload.length;
+    header.checksum = batchChecksum(payload.bytes, payload.length);
+
+    NSMutableData *record = [NSMutableData dataWithCapacity:sizeof(header) + payload.length];
+    [record appendBytes:&header length:sizeof(header)];
+    [record appendData:payload];
+    return record;
+}
+
+// Runs on the storage queue, the only place touching the file once it was loaded.
+// Every transaction committed since the last run goes out with one gathered write and one
+// fsync, the records are handed to the kernel as they are instead of being copied together.
+- (BOOL)writePendingRecordsI {
+    NSArray<NSData *> *records;
+    @synchronized (self) {
+        records = [self.pendingRecords copy];
+        [self.pendingRecords removeAllObjects];
+    }
+    if (records.count == 0) {
+        return YES;
+    }
+
+    if (self.fileDescriptor < 0 && self.filePath != nil) {
+        int fd = open([self.filePath fileSystemRepresentation], O_WRONLY | O_CREAT | O_APPEND, S_IRUSR | S_IWUSR);
+        if (fd >= 0) {
+            self.fileDescriptor = fd;
+            if (self.fileSize == 0) {
+                [ALTUtil excludeFromBackup:self.filePath];
+            }
+        }
+    }
+
+    BOOL written = NO;
+    if (self.fileDescriptor >= 0) {
+        written = [ALTStorageWriter writeBuffers:records toFileDescriptor:self.fileDescriptor]
+            && [ALTStorageWriter syncFileDescriptor:self.fileDescriptor];
+        if (!written) {
+            // leave no partial batch behind for the next commit to append to
+            ftruncate(self.fileDescriptor, (off_t)self.fileSize);
+        }
+    }
+    if (!written) {
+        [[ALTAlltrackFactory logger] error:@"Failed to write state store (%d)", errno];
+        // retried ahead of newer records with the next commit
+        @synchronized (self) {
+            [self.pendingRecords insertObjects:records
+                                     atIndexes:[NSIndexSet indexSetWithIndexesInRange:NSMakeRange(0, records.count)]];
+        }
+        return NO;
+    }
+
+    for (NSData *record in records) {
+        self.fileSize += record.length;
+    }
+    [self compactIfNeededI];
+    return YES;
+}
+
+- (void)applyBatchI:(NSDictionary *)batch {
+    NSDictionary *sets = [batch objectForKey:kBatchSetKey];
+    NSArray *removals = [batch objectForKey:kBatchRemoveKey];
+
+    if ([removals isKindOfClass:[NSArray class]]) {
+        for (NSString *key in removals) {
+            NSData *previous = [self.values objectForKey:key];
+            if (previous != nil) {
+                self.liveSize -= previous.length;
+                [self.values removeObjectForKey:key];
+            }
+        }
+    }
+    if ([sets isKindOfClass:[NSDictionary class]]) {
+        for (NSString *key in sets) {
+            NSData *data = [sets objectForKey:key];
+            if (![data isKindOfClass:[NSData class]]) {
+                continue;
+            }
+            NSData *previous = [self.values objectForKey:key];
+            if (previous != nil) {
+                self.liveSize -= previous.length;
+            }
+            self.liveSize += data.length;
+            [self.values setObject:data forKey:key];
+        }
+    }
+}
+
+- (void)compactIfNeededI {
+    NSDictionary *snapshot;
+    @synchronized (self) {
+        if (self.fileSize < kCompactionMinSize || self.fileSize < self.liveSize * 2) {
+            return;
+        }
+        // may include records still pending, appending them again later changes nothing
+        snapshot = @{kBatchSetKey: [self.values copy], kBatchRemoveKey: @[]};
+    }
+
+    NSData *record = [self recordWithBatch:snapshot];
+    if (record == nil) {
+        return;
+    }
+    // written next to the store and renamed over it, the old file stays valid until then
+    if (![ALTStorageWriter replaceFileAtPath:self.filePath withData:record]) {
+        [[ALTAlltrackFactory logger] debug:@"Failed to compact state store (%d)", errno];
+        return;
+    }
+    [ALTUtil excludeFromBackup:self.filePath];
+
+    close(self.fileDescriptor);
+    self.fileDescriptor = -1;
+    self.fileSize = record.length;
+    [[ALTAlltrackFactory logger] verbose:@"Compacted state store to %lu bytes", (unsigned long)record.length];
+}
+
+@end
@@ -0,0 +1,33 @@
+#import <Foundation/Foundation.h>
+
+// Runs storage writes on a dedicated queue, away from the handler queues.
+// Writes submitted within the commit window are committed together. A newer write for the
+// same key replaces the pending one, so a burst of changes to one file costs a single write.
+@interface ALTStorageWriter : NSObject
+
++ (ALTStorageWriter *)sharedWriter;
+
+- (id)initWithCommitWindow:(NSTimeInterval)commitWindow;
+
+// The completion is called on the storage queue once the write that covers this submission
+// returned, with its result.
+- (void)submitWriteForKey:(NSString *)key
+                    block:(BOOL (^)(void))writeBlock
+               completion:(void (^)(BOOL written))completion;
+
+// Blocks until everything submitted so far is written. Not to be called from the storage queue.
+- (void)flush;
+
+// Writes the buffers in order with as few syscalls as the kernel allows.
++ (BOOL)writeBuffers:(NSArray<NSData *> *)buffers
+    toFileDescriptor:(int)fileDescriptor;
+
+// Syncs the file through to the storage device, not only to its cache.
++ (BOOL)syncFileDescriptor:(int)fileDescriptor;
+
+// Written to a temporary file that is synced and then renamed over the file.
++ (BOOL)replaceFileAtPath:(NSString *)path withData:(NSData *)data;
+
++ (BOOL)replaceFileAtPath:(NSString *)path withBuffers:(NSArray<NSData *> *)buffers;
+
+@end
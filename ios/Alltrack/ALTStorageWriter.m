@@ -0,0 +1,206 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#import "ALTStorageWriter.h"
+
+static const char * const kInternalQueueName = "io.alltrack.StorageWriter";
+static const NSTimeInterval kDefaultCommitWindow = 0.005;
+// buffers passed to a single writev, well below IOV_MAX
+static const NSUInteger kMaxIoVectors = 64;
+
+static ALTStorageWriter *sharedWriter = nil;
+
+#pragma mark - pending write
+@interface ALTPendingWrite : NSObject
+
+@property (nonatomic, copy) BOOL (^block)(void);
+@property (nonatomic, strong) NSMutableArray *completions;
+
+@end
+
+@implementation ALTPendingWrite
+
+- (id)init {
+    self = [super init];
+    if (self == nil) return nil;
+
+    self.completions = [NSMutableArray array];
+
+    return self;
+}
+
+@end
+
+#pragma mark - private
+@interface ALTStorageWriter()
+
+@property (nonatomic, strong) dispatch_queue_t internalQueue;
+@property (nonatomic, assign) NSTimeInterval commitWindow;
+@property (nonatomic, strong) NSMutableDictionary<NSString *, ALTPendingWrite *> *pendingWrites;
+@property (nonatomic, strong) NSMutableArray<NSString *> *pendingKeys;
+@property (nonatomic, assign) BOOL commitScheduled;
+
+@end
+
+#pragma mark -
+@implementation ALTStorageWriter
+
++ (ALTStorageWriter *)sharedWriter {
+    @synchronized (self) {
+        if (sharedWriter == nil) {
+            sharedWriter = [[ALTStorageWriter alloc] initWithCommitWindow:kDefaultCommitWindow];
+        }
+        return sharedWriter;
+    }
+}
+
+- (id)initWithCommitWindow:(NSTimeInterval)commitWindow {
+    self = [super init];
+    if (self == nil) return nil;
+
+    dispatch_queue_attr_t attributes =
+        dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0);
+    self.internalQueue = dispatch_queue_create(kInternalQueueName, attributes);
+    self.commitWindow = commitWindow;
+    self.pendingWrites = [NSMutableDictionary dictionary];
+    self.pendingKeys = [NSMutableArray array];
+    self.commitScheduled = NO;
+
+    return self;
+}
+
+- (void)submitWriteForKey:(NSString *)key
+                    block:(BOOL (^)(void))writeBlock
+               completion:(void (^)(BOOL written))completion {
+    if (key == nil || writeBlock == nil) {
+        return;
+    }
+
+    @synchronized (self) {
+        ALTPendingWrite *pendingWrite = [self.pendingWrites objectForKey:key];
+        if (pendingWrite == nil) {
+            pendingWrite = [[ALTPendingWrite alloc] init];
+            [self.pendingWrites setObject:pendingWrite forKey:key];
+            [self.pendingKeys addObject:key];
+        }
+        // only the latest state needs to reach the disk
+        pendingWrite.block = writeBlock;
+        if (completion != nil) {
+            [pendingWrite.completions addObject:[completion copy]];
+        }
+
+        if (self.commitScheduled) {
+            return;
+        }
+        self.commitScheduled = YES;
+    }
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.commitWindow * NSEC_PER_SEC)),
+                   self.internalQueue,
+                   ^{
+                       [self commitI];
+                   });
+}
+
+- (void)flush {
+    dispatch_sync(self.internalQueue, ^{
+        [self commitI];
+    });
+}
+
++ (BOOL)writeBuffers:(NSArray<NSData *> *)buffers
+    toFileDescriptor:(int)fileDescriptor {
+    struct iovec vectors[kMaxIoVectors];
+    NSUInteger next = 0;
+    while (next < buffers.count) {
+        NSUInteger count = 0;
+        while (count < kMaxIoVectors && next + count < buffers.count) {
+            NSData *buffer = [buffers objectAtIndex:next + count];
+            vectors[count].iov_base = (void *)buffer.bytes;
+            vectors[count].iov_len = buffer.length;
+            count++;
+        }
+        next += count;
+
+        struct iovec *remaining = vectors;
+        while (count > 0) {
+            ssize_t written = writev(fileDescriptor, remaining, (int)count);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return NO;
+            }
+            // a short write stops anywhere, skip what made it and resume mid-buffer
+            while (count > 0 && (size_t)written >= remaining->iov_len) {
+                written -= remaining->iov_len;
+                remaining++;
+                count--;
+            }
+            if (count > 0) {
+                remaining->iov_base = (uint8_t *)remaining->iov_base + written;
+                remaining->iov_len -= (size_t)written;
+            }
+        }
+    }
+    return YES;
+}
+
++ (BOOL)syncFileDescriptor:(int)fileDescriptor {
+#ifdef F_FULLFSYNC
+    // fsync only hands the data to the drive, which may keep it in its cache over a power loss
+    if (fcntl(fileDescriptor, F_FULLFSYNC) == 0) {
+        return YES;
+    }
+    // not supported by every file system, fsync is the best there is then
+#endif
+    return fsync(fileDescriptor) == 0;
+}
+
++ (BOOL)replaceFileAtPath:(NSString *)path withData:(NSData *)data {
+    return [ALTStorageWriter replaceFileAtPath:path withBuffers:data != nil ? @[data] : @[]];
+}
+
++ (BOOL)replaceFileAtPath:(NSString *)path withBuffers:(NSArray<NSData *> *)buffers {
+    NSString *temporaryPath = [path stringByAppendingString:@".tmp"];
+    int fd = open([temporaryPath fileSystemRepresentation], O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd < 0) {
+        return NO;
+    }
+    BOOL written = [ALTStorageWriter writeBuffers:buffers toFileDescriptor:fd]
+        && [ALTStorageWriter syncFileDescriptor:fd];
+    close(fd);
+    if (!written || rename([temporaryPath fileSystemRepresentation], [path fileSystemRepresentation]) != 0) {
+        unlink([temporaryPath fileSystemRepresentation]);
+        return NO;
+    }
+    return YES;
+}
+
+#pragma mark - internal
+
+- (void)commitI {
+    NSArray<NSString *> *keys;
+    NSDictionary<NSString *, ALTPendingWrite *> *writes;
+    @synchronized (self) {
+        keys = [self.pendingKeys copy];
+        writes = [self.pendingWrites copy];
+        [self.pendingKeys removeAllObjects];
+        [self.pendingWrites removeAllObjects];
+        self.commitScheduled = NO;
+    }
+
+    for (NSString *key in keys) {
+        ALTPendingWrite *pendingWrite = [writes objectForKey:key];
+        BOOL written = pendingWrite.block();
+        for (void (^completion)(BOOL) in pendingWrite.completions) {
+            completion(written);
+        }
+    }
+}
+
+@end
@@ -1,15 +1,19 @@
 #import "ALTTimerCycle.h"
+#import "ALTTimerWheel.h"
 #import "ALTLogger.h"
 #import "ALTAlltrackFactory.h"
 #import "ALTUtil.h"
 
-static const uint64_t kTimerLeeway   =  1 * NSEC_PER_SEC; // 1 second
-
 #pragma mark - private
 @interface ALTTimerCycle()
 
-@property (nonatomic, strong) dispatch_source_t source;
+@property (nonatomic, strong) dispatch_queue_t internalQueue;
+@property (nonatomic, strong) ALTTimerWheelEntry *entry;
+@property (nonatomic, copy) dispatch_block_t block;
+@property (nonatomic, assign) NSTimeInterval intervalTime;
+@property (nonatomic, strong) NSDate *fireDate;
 @property (nonatomic, assign) BOOL suspended;
+@property (nonatomic, assign) BOOL cancelled;
 @property (nonatomic, weak) id<ALTLogger> logger;
 @property (nonatomic, copy) NSString *name;
 
@@ -37,21 +41,17 @@ static const uint64_t kTimerLeeway   =  1 * NSEC_PER_SEC; // 1 second
     self = [super init];
     if (self == nil) return nil;
 
-    self.source = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+    self.internalQueue = queue;
+    self.block = block;
+    self.intervalTime = intervalTime;
     self.logger = ALTAlltrackFactory.logger;
     self.name = name;
 
-    dispatch_source_set_timer(self.source,
-                              dispatch_walltime(NULL, startTime * NSEC_PER_SEC),
-                              intervalTime * NSEC_PER_SEC,
-                              kTimerLeeway);
-
-    dispatch_source_set_event_handler(self.source,
-                                      ^{ [self.logger verbose:@"%@ fired", self.name];
-                                          block();
-                                      });
+    // first fire is counted from the creation of the timer, like the dispatch source it replaces
+    self.fireDate = [[NSDate alloc] initWithTimeIntervalSinceNow:startTime];
 
     self.suspended = YES;
+    self.cancelled = NO;
 
     NSString * startTimeFormatted = [ALTUtil secondsNumberFormat:startTime];
     NSString * intervalTimeFormatted = [ALTUtil secondsNumberFormat:intervalTime];
@@ -62,7 +62,7 @@ static const uint64_t kTimerLeeway   =  1 * NSEC_PER_SEC; // 1 second
 }
 
 - (void)resume {
-    if (self.source == nil) return;
+    if (self.cancelled) return;
     if (!self.suspended) {
         [self.logger verbose:@"%@ is already started", self.name];
         return;
@@ -70,32 +70,68 @@ static const uint64_t kTimerLeeway   =  1 * NSEC_PER_SEC; // 1 second
 
     [self.logger verbose:@"%@ starting", self.name];
 
-    dispatch_resume(self.source);
     self.suspended = NO;
+    [self scheduleNextFire];
 }
 
 - (void)suspend {
-    if (self.source == nil) return;
+    if (self.cancelled) return;
     if (self.suspended) {
         [self.logger verbose:@"%@ is already suspended", self.name];
         return;
     }
 
     [self.logger verbose:@"%@ suspended", self.name];
-    dispatch_suspend(self.source);
+    [self.entry cancel];
+    self.entry = nil;
     self.suspended = YES;
 }
 
 - (void)cancel {
-    if (self.source != nil) {
-        [self resume];
-        dispatch_cancel(self.source);
-    }
-    self.source = nil;
+    [self.entry cancel];
+    self.entry = nil;
+    self.cancelled = YES;
 }
 
 - (void)dealloc {
+    [self.entry cancel];
     [self.logger verbose:@"%@ dealloc", self.name];
 }
 
+#pragma mark - private
+
+- (void)scheduleNextFire {
+    // a fire missed while suspended happens right away on resume
+    NSTimeInterval fireIn = MAX(0, [self.fireDate timeIntervalSinceNow]);
+
+    __weak __typeof__(self) weakSelf = self;
+    self.entry = [[ALTTimerWheel sharedWheel] scheduleBlock:^{
+        __typeof__(self) strongSelf = weakSelf;
+        if (strongSelf == nil) return;
+
+        [strongSelf fired];
+    }
+                                                      queue:self.internalQueue
+                                                      after:fireIn];
+}
+
+- (void)fired {
+    if (self.suspended || self.cancelled) {
+        return;
+    }
+
+    // counted from the previous deadline, so the lateness of each fire doesn't add up;
+    // periods missed altogether, e.g. while the app was suspended, are skipped instead of caught up
+    NSDate *nextFireDate = [self.fireDate dateByAddingTimeInterval:self.intervalTime];
+    NSTimeInterval behind = -[nextFireDate timeIntervalSinceNow];
+    if (behind > 0 && self.intervalTime > 0) {
+        nextFireDate = [nextFireDate dateByAddingTimeInterval:ceil(behind / self.intervalTime) * self.intervalTime];
+    }
+    self.fireDate = nextFireDate;
+    [self scheduleNextFire];
+
+    [self.logger verbose:@"%@ fired", self.name];
+    self.block();
+}
+
 @end
@@ -1,17 +1,15 @@
 #import "ALTTimerOnce.h"
+#import "ALTTimerWheel.h"
 #import "ALTLogger.h"
 #import "ALTAlltrackFactory.h"
 #import "ALTUtil.h"
 
-static const uint64_t kTimerLeeway   =  1 * NSEC_PER_SEC; // 1 second
-
 #pragma mark - private
 @interface ALTTimerOnce()
 
 @property (nonatomic, strong) dispatch_queue_t internalQueue;
-@property (nonatomic, strong) dispatch_source_t source;
+@property (nonatomic, strong) ALTTimerWheelEntry *entry;
 @property (nonatomic, copy) dispatch_block_t block;
-@property (nonatomic, assign, readonly) dispatch_time_t start;
 @property (nonatomic, strong) NSDate * fireDate;
 @property (nonatomic, weak) id<ALTLogger> logger;
 @property (nonatomic, copy) NSString *name;
@@ -62,33 +60,21 @@ static const uint64_t kTimerLeeway   =  1 * NSEC_PER_SEC; // 1 second
     NSString * fireInFormatted = [ALTUtil secondsNumberFormat:[self fireIn]];
     [self.logger verbose:@"%@ starting. Launching in %@ seconds", self.name, fireInFormatted];
 
-    self.source = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.internalQueue);
-
-    if (!self.source) {
-        [self.logger error:@"%@ could not start witouth source", self.name];
-        return;
-    }
     if (!self.block) {
         [self.logger error:@"%@ could not start witouth block", self.name];
         return;
     }
 
-    dispatch_source_set_timer(self.source,
-                              dispatch_walltime(NULL, startIn * NSEC_PER_SEC),
-                              DISPATCH_TIME_FOREVER,
-                              kTimerLeeway);
-
-
-    dispatch_resume(self.source);
-
-    dispatch_source_set_event_handler(self.source, self.block);
+    self.entry = [[ALTTimerWheel sharedWheel] scheduleBlock:self.block
+                                                      queue:self.internalQueue
+                                                      after:startIn];
 }
 
 - (void)cancel:(BOOL)log {
-    if (self.source != nil) {
-        dispatch_cancel(self.source);
+    if (self.entry != nil) {
+        [self.entry cancel];
     }
-    self.source = nil;
+    self.entry = nil;
     if (log) {
         [self.logger verbose:@"%@ canceled", self.name];
     }
@@ -99,6 +85,7 @@ static const uint64_t kTimerLeeway   =  1 * NSEC_PER_SEC; // 1 second
 }
 
 - (void)dealloc {
+    [self.entry cancel];
     [self.logger verbose:@"%@ dealloc", self.name];
 }
 
@@ -0,0 +1,38 @@
+#import <Foundation/Foundation.h>
+
+@interface ALTTimerWheelEntry : NSObject
+
+// Safe to call from any queue. The block will not run once this returns,
+// as long as it is called from the queue the block was scheduled on.
+- (void)cancel;
+
+- (BOOL)isCancelled;
+
+@end
+
+// Hierarchical timer wheel driving all SDK timers from a single wakeup source.
+// Deadlines are rounded up to ticks of half the tolerance window, so timers expiring close
+// to each other fire together, and the wakeup gets the other half as leeway; a timer fires
+// at most the tolerance late. Scheduling and cancelling never walk the pending timers.
+@interface ALTTimerWheel : NSObject
+
++ (ALTTimerWheel *)sharedWheel;
+
+// Replaces the shared wheel, e.g. with one running on a virtual clock.
++ (void)setSharedWheel:(ALTTimerWheel *)wheel;
+
+- (id)initWithTolerance:(NSTimeInterval)tolerance
+           virtualClock:(BOOL)virtualClock;
+
+- (ALTTimerWheelEntry *)scheduleBlock:(dispatch_block_t)block
+                                queue:(dispatch_queue_t)queue
+                                after:(NSTimeInterval)delay;
+
+- (NSTimeInterval)now;
+
+// Only for wheels running on a virtual clock. Fires everything that expires on the way.
+- (void)advanceVirtualClockBy:(NSTimeInterval)seconds;
+
+- (void)teardown;
+
+@end
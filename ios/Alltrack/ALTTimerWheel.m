@@ -0,0 +1,373 @@
+#include <stdatomic.h>
+
+#import "ALTTimerWheel.h"
+
+static const char * const kInternalQueueName = "io.alltrack.TimerWheel";
+static const NSUInteger kSlotBits = 6;
+static const NSUInteger kSlotCount = 1 << kSlotBits;
+static const NSUInteger kLevelCount = 4;
+// same as the leeway each dispatch source timer used to have
+static const NSTimeInterval kDefaultTolerance = 1.0;
+// half of the tolerance goes to rounding deadlines up to a tick, the other half is timer leeway
+static const NSUInteger kTicksPerTolerance = 2;
+
+static ALTTimerWheel *sharedWheel = nil;
+
+@interface ALTTimerWheel()
+
+@property (nonatomic, strong) dispatch_queue_t internalQueue;
+@property (nonatomic, strong) dispatch_source_t source;
+@property (nonatomic, assign) NSTimeInterval tolerance;
+@property (nonatomic, assign) NSTimeInterval tickLength;
+@property (nonatomic, assign) BOOL virtualClock;
+@property (nonatomic, assign) NSTimeInterval virtualNow;
+@property (nonatomic, assign) NSTimeInterval origin;
+@property (nonatomic, assign) uint64_t currentTick;
+@property (nonatomic, strong) NSArray<NSArray<NSMutableSet *> *> *levels;
+@property (nonatomic, assign) NSUInteger entryCount;
+// bit n of a level is set while its slot n holds entries
+@property (nonatomic, assign) uint64_t *occupiedSlots;
+
+- (void)removeEntry:(ALTTimerWheelEntry *)entry;
+
+@end
+
+#pragma mark - entry
+@interface ALTTimerWheelEntry() {
+    atomic_bool _cancelled;
+}
+
+@property (nonatomic, copy) dispatch_block_t block;
+@property (nonatomic, strong) dispatch_queue_t queue;
+@property (nonatomic, assign) NSTimeInterval delay;
+@property (nonatomic, assign) NSTimeInterval scheduledAt;
+@property (nonatomic, assign) uint64_t deadlineTick;
+@property (nonatomic, assign) NSInteger level;
+@property (nonatomic, assign) NSUInteger slot;
+@property (nonatomic, weak) ALTTimerWheel *wheel;
+
+@end
+
+@implementation ALTTimerWheelEntry
+
+- (id)init {
+    self = [super init];
+    if (self == nil) return nil;
+
+    atomic_init(&_cancelled, false);
+    self.level = -1;
+
+    return self;
+}
+
+- (void)cancel {
+    if (atomic_exchange(&_cancelled, true)) {
+        return;
+    }
+    [self.wheel removeEntry:self];
+}
+
+- (BOOL)isCancelled {
+    return atomic_load(&_cancelled);
+}
+
+@end
+
+#pragma mark -
+@implementation ALTTimerWheel
+
++ (ALTTimerWheel *)sharedWheel {
+    @synchronized (self) {
+        if (sharedWheel == nil) {
+            sharedWheel = [[ALTTimerWheel alloc] initWithTolerance:kDefaultTolerance virtualClock:NO];
+        }
+        return sharedWheel;
+    }
+}
+
++ (void)setSharedWheel:(ALTTimerWheel *)wheel {
+    @synchronized (self) {
+        if (sharedWheel != nil && sharedWheel != wheel) {
+            [sharedWheel teardown];
+        }
+        sharedWheel = wheel;
+    }
+}
+
+- (id)initWithTolerance:(NSTimeInterval)tolerance
+           virtualClock:(BOOL)virtualClock
+{
+    self = [super init];
+    if (self == nil) return nil;
+
+    self.tolerance = tolerance > 0 ? tolerance : kDefaultTolerance;
+    self.tickLength = self.tolerance / kTicksPerTolerance;
+    self.virtualClock = virtualClock;
+    self.virtualNow = 0;
+    self.origin = [self now];
+    self.currentTick = 0;
+    self.entryCount = 0;
+
+    NSMutableArray *levels = [NSMutableArray arrayWithCapacity:kLevelCount];
+    for (NSUInteger level = 0; level < kLevelCount; level++) {
+        NSMutableArray *slots = [NSMutableArray arrayWithCapacity:kSlotCount];
+        for (NSUInteger slot = 0; slot < kSlotCount; slot++) {
+            [slots addObject:[NSMutableSet set]];
+        }
+        [levels addObject:slots];
+    }
+    self.levels = levels;
+    self.occupiedSlots = calloc(kLevelCount, sizeof(uint64_t));
+
+    self.internalQueue = dispatch_queue_create(kInternalQueueName, DISPATCH_QUEUE_SERIAL);
+
+    if (!virtualClock) {
+        self.source = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, self.internalQueue);
+        __weak __typeof__(self) weakSelf = self;
+        dispatch_source_set_event_handler(self.source, ^{
+            __typeof__(self) strongSelf = weakSelf;
+            if (strongSelf == nil) return;
+
+            [strongSelf advanceI];
+        });
+        dispatch_source_set_timer(self.source, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        dispatch_resume(self.source);
+    }
+
+    return self;
+}
+
+- (ALTTimerWheelEntry *)scheduleBlock:(dispatch_block_t)block
+                                queue:(dispatch_queue_t)queue
+                                after:(NSTimeInterval)delay
+{
+    ALTTimerWheelEntry *entry = [[ALTTimerWheelEntry alloc] init];
+    entry.block = block;
+    entry.queue = queue;
+    entry.delay = delay;
+    entry.scheduledAt = [self now];
+    entry.wheel = self;
+
+    if (block == nil || queue == nil) {
+        [entry cancel];
+        return entry;
+    }
+
+    dispatch_async(self.internalQueue, ^{
+        [self scheduleEntryI:entry];
+    });
+
+    return entry;
+}
+
+- (NSTimeInterval)now {
+    if (self.virtualClock) {
+        return self.virtualNow;
+    }
+    return CFAbsoluteTimeGetCurrent();
+}
+
+- (void)advanceVirtualClockBy:(NSTimeInterval)seconds {
+    if (!self.virtualClock || seconds < 0) {
+        return;
+    }
+    dispatch_sync(self.internalQueue, ^{
+        self.virtualNow = self.virtualNow + seconds;
+        [self advanceI];
+    });
+}
+
+- (void)removeEntry:(ALTTimerWheelEntry *)entry {
+    dispatch_async(self.internalQueue, ^{
+        [self unlinkEntryI:entry];
+        [self rearmI];
+    });
+}
+
+- (void)teardown {
+    if (self.source != nil) {
+        dispatch_source_cancel(self.source);
+    }
+    self.source = nil;
+    dispatch_queue_t internalQueue = self.internalQueue;
+    if (internalQueue == nil) {
+        return;
+    }
+    dispatch_async(internalQueue, ^{
+        for (NSArray<NSMutableSet *> *slots in self.levels) {
+            for (NSMutableSet *slot in slots) {
+                [slot removeAllObjects];
+            }
+        }
+        memset(self.occupiedSlots, 0, kLevelCount * sizeof(uint64_t));
+        self.entryCount = 0;
+    });
+}
+
+- (void)dealloc {
+    free(self.occupiedSlots);
+}
+
+#pragma mark - internal
+
+- (NSTimeInterval)timeOfTickI:(uint64_t)tick {
+    return self.origin + tick * self.tickLength;
+}
+
+- (uint64_t)tickForTimeI:(NSTimeInterval)time {
+    // clock going back does not move the wheel back
+    NSTimeInterval elapsed = MAX(0, time - [self timeOfTickI:self.currentTick]);
+    return self.currentTick + (uint64_t)floor(elapsed / self.tickLength);
+}
+
+- (void)scheduleEntryI:(ALTTimerWheelEntry *)entry {
+    if ([entry isCancelled]) {
+        return;
+    }
+
+    // bring the wheel up to date first, so that the deadline is relative to the present
+    [self advanceWheelToTickI:[self tickForTimeI:[self now]]];
+
+    NSTimeInterval deadline = entry.scheduledAt + MAX(0, entry.delay);
+    NSTimeInterval untilDeadline = deadline - [self timeOfTickI:self.currentTick];
+    entry.deadlineTick = self.currentTick + (uint64_t)ceil(MAX(0, untilDeadline) / self.tickLength);
+
+    [self insertEntryI:entry];
+    [self rearmI];
+}
+
+- (void)insertEntryI:(ALTTimerWheelEntry *)entry {
+    if (entry.deadlineTick <= self.currentTick) {
+        [self fireEntryI:entry];
+        return;
+    }
+
+    uint64_t delta = entry.deadlineTick - self.currentTick;
+    uint64_t slotTick = entry.deadlineTick;
+    NSUInteger level = 0;
+    while (level < kLevelCount - 1 && delta >= (1ULL << (kSlotBits * (level + 1)))) {
+        level++;
+    }
+    uint64_t wheelSpan = 1ULL << (kSlotBits * kLevelCount);
+    if (delta >= wheelSpan) {
+        // beyond the last level, park it in the furthest slot and place it again when it cascades
+        slotTick = self.currentTick + wheelSpan - 1;
+    }
+
+    entry.level = level;
+    entry.slot = (NSUInteger)((slotTick >> (kSlotBits * level)) & (kSlotCount - 1));
+    [self.levels[level][entry.slot] addObject:entry];
+    self.occupiedSlots[level] |= 1ULL << entry.slot;
+    self.entryCount++;
+}
+
+- (void)unlinkEntryI:(ALTTimerWheelEntry *)entry {
+    if (entry.level < 0) {
+        return;
+    }
+    NSMutableSet *slot = self.levels[entry.level][entry.slot];
+    if ([slot containsObject:entry]) {
+        [slot removeObject:entry];
+        self.entryCount--;
+        if (slot.count == 0) {
+            self.occupiedSlots[entry.level] &= ~(1ULL << entry.slot);
+        }
+    }
+    entry.level = -1;
+}
+
+- (void)advanceI {
+    [self advanceWheelToTickI:[self tickForTimeI:[self now]]];
+    [self rearmI];
+}
+
+- (void)advanceWheelToTickI:(uint64_t)targetTick {
+    while (self.currentTick < targetTick) {
+        if (self.entryCount == 0) {
+            self.currentTick = targetTick;
+            return;
+        }
+
+        self.currentTick++;
+
+        // move entries of higher levels down when their slot comes up
+        for (NSUInteger level = 1; level < kLevelCount; level++) {
+            uint64_t levelMask = (1ULL << (kSlotBits * level)) - 1;
+            if ((self.currentTick & levelMask) != 0) {
+                break;
+            }
+            NSUInteger slotIndex = (NSUInteger)((self.currentTick >> (kSlotBits * level)) & (kSlotCount - 1));
+            NSMutableSet *slot = self.levels[level][slotIndex];
+            NSArray *cascading = [slot allObjects];
+            [slot removeAllObjects];
+            self.occupiedSlots[level] &= ~(1ULL << slotIndex);
+            self.entryCount -= cascading.count;
+            for (ALTTimerWheelEntry *entry in cascading) {
+                entry.level = -1;
+                [self insertEntryI:entry];
+            }
+        }
+
+        NSUInteger expiringSlot = (NSUInteger)(self.currentTick & (kSlotCount - 1));
+        NSMutableSet *expiring = self.levels[0][expiringSlot];
+        if (expiring.count == 0) {
+            continue;
+        }
+        NSArray *expired = [expiring allObjects];
+        [expiring removeAllObjects];
+        self.occupiedSlots[0] &= ~(1ULL << expiringSlot);
+        self.entryCount -= expired.count;
+        for (ALTTimerWheelEntry *entry in expired) {
+            entry.level = -1;
+            [self fireEntryI:entry];
+        }
+    }
+}
+
+- (void)fireEntryI:(ALTTimerWheelEntry *)entry {
+    if ([entry isCancelled]) {
+        return;
+    }
+    dispatch_async(entry.queue, ^{
+        // cancelled after expiring but before running on its queue
+        if ([entry isCancelled]) {
+            return;
+        }
+        entry.block();
+    });
+}
+
+- (void)rearmI {
+    if (self.source == nil) {
+        return;
+    }
+    if (self.entryCount == 0) {
+        dispatch_source_set_timer(self.source, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+        return;
+    }
+
+    // a single wakeup for the next tick with work, the earliest occupied slot of each level
+    // found from its bitmap; for the higher levels that is when the slot cascades down
+    uint64_t earliestTick = UINT64_MAX;
+    for (NSUInteger level = 0; level < kLevelCount; level++) {
+        uint64_t occupied = self.occupiedSlots[level];
+        if (occupied == 0) {
+            continue;
+        }
+        NSUInteger shift = kSlotBits * level;
+        uint64_t levelTick = self.currentTick >> shift;
+        // rotate so that bit 0 is the slot right after the current one
+        NSUInteger start = (NSUInteger)((levelTick + 1) & (kSlotCount - 1));
+        uint64_t rotated = start == 0 ? occupied : (occupied >> start) | (occupied << (kSlotCount - start));
+        uint64_t slotsAhead = (uint64_t)__builtin_ctzll(rotated) + 1;
+        earliestTick = MIN(earliestTick, (levelTick + slotsAhead) << shift);
+    }
+
+    NSTimeInterval delay = MAX(0, [self timeOfTickI:earliestTick] - [self now]);
+    dispatch_source_set_timer(self.source,
+                              dispatch_walltime(NULL, (int64_t)(delay * NSEC_PER_SEC)),
+                              DISPATCH_TIME_FOREVER,
+                              (uint64_t)((self.tolerance - self.tickLength) * NSEC_PER_SEC));
+}
+
+@end
@@ -0,0 +1,34 @@
+#import <Foundation/Foundation.h>
+
+typedef NS_ENUM(NSInteger, ALTTransactionIdMatch) {
+    ALTTransactionIdMatchNone = 0,
+    // the id itself is among the most recently added ones
+    ALTTransactionIdMatchExact = 1,
+    // only its fingerprint was found, which can be a collision with another id,
+    // so it isn't enough to drop the id as a duplicate
+    ALTTransactionIdMatchFingerprint = 2
+};
+
+// Remembers transaction ids beyond the last ten kept in the activity state.
+// The latest thousand ids are kept as they are and matched exactly. Older ones are stored as
+// 16 bit fingerprints in a cuckoo filter, so lookups take constant time and a capacity of a
+// thousand ids fits in a few kilobytes. Fingerprints can collide, so roughly one in four
+// thousand new ids matches an older fingerprint.
+// Once the capacity is reached, the filter is kept as the previous generation and a new one
+// is started, so between one and two times the capacity of the latest ids are remembered.
+@interface ALTTransactionIdIndex : NSObject
+
++ (ALTTransactionIdIndex *)indexWithFileName:(NSString *)fileName
+                                    capacity:(NSUInteger)capacity;
+
+- (ALTTransactionIdMatch)matchTransactionId:(NSString *)transactionId;
+
+- (void)addTransactionId:(NSString *)transactionId;
+
+// Hands the index to the storage writer, if it changed since the last write.
+// The file is written off the calling queue, bursts of changes are written once.
+- (void)write;
+
+- (NSUInteger)capacity;
+
+@end
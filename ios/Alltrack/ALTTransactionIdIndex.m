@@ -0,0 +1,356 @@
+#import "ALTTransactionIdIndex.h"
+#import "ALTAlltrackFactory.h"
+#import "ALTStorageWriter.h"
+#import "ALTUtil.h"
+
+static const NSUInteger kDefaultCapacity = 1000;
+static const NSUInteger kMaxCapacity = 1000000;
+static const NSUInteger kBucketSize = 4;
+static const NSUInteger kGenerationCount = 2;
+static const NSUInteger kMaxKicks = 500;
+static const NSUInteger kRecentIdCount = 1000;
+// buckets are sized so that the filter is at most this full when it rotates
+static const double kMaxLoadFactor = 0.9;
+
+static const uint32_t kFileMagic = 0x414c5458; // "ALTX"
+// version 2 appends the recent ids, each as a 16 bit length followed by its utf8 bytes
+static const uint32_t kFileVersion = 2;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t bucketCount;
+    uint32_t current;
+    uint32_t counts[2];
+} ALTTransactionIdIndexHeader;
+
+static uint64_t transactionIdHash(NSString *transactionId) {
+    // FNV-1a, stable across launches unlike -[NSString hash]
+    const char *bytes = [transactionId UTF8String];
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char *c = bytes; c != NULL && *c != '\0'; c++) {
+        hash ^= (uint8_t)*c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#pragma mark - private
+@interface ALTTransactionIdIndex() {
+    uint16_t *_slots[kGenerationCount];
+    NSUInteger _counts[kGenerationCount];
+    NSUInteger _current;
+    NSUInteger _bucketCount;
+}
+
+@property (nonatomic, copy) NSString *fileName;
+@property (nonatomic, copy) NSString *filePath;
+@property (nonatomic, assign) NSUInteger capacity;
+@property (nonatomic, strong) NSMutableOrderedSet *recentIds;
+// guarded by self, the storage writer takes its snapshot from its own queue
+@property (nonatomic, assign) BOOL changed;
+@property (nonatomic, assign) BOOL writeSubmitted;
+
+@end
+
+#pragma mark -
+@implementation ALTTransactionIdIndex
+
++ (ALTTransactionIdIndex *)indexWithFileName:(NSString *)fileName
+                                    capacity:(NSUInteger)capacity {
+    return [[ALTTransactionIdIndex alloc] initWithFileName:fileName capacity:capacity];
+}
+
+- (id)initWithFileName:(NSString *)fileName
+              capacity:(NSUInteger)capacity {
+    self = [super init];
+    if (self == nil) return nil;
+
+    if (capacity == 0) {
+        capacity = kDefaultCapacity;
+    }
+    self.capacity = MIN(capacity, kMaxCapacity);
+
+    NSUInteger bucketCount = 1;
+    while (bucketCount * kBucketSize * kMaxLoadFactor < self.capacity) {
+        bucketCount <<= 1;
+    }
+    _bucketCount = bucketCount;
+    for (NSUInteger i = 0; i < kGenerationCount; i++) {
+        _slots[i] = calloc(_bucketCount * kBucketSize, sizeof(uint16_t));
+        if (_slots[i] == NULL) {
+            return nil;
+        }
+        _counts[i] = 0;
+    }
+    _current = 0;
+    self.recentIds = [NSMutableOrderedSet orderedSetWithCapacity:MIN(self.capacity, kRecentIdCount)];
+
+    self.fileName = fileName;
+    self.filePath = [ALTUtil getFilePathInAppSupportDir:fileName];
+    [self read];
+    self.changed = NO;
+
+    return self;
+}
+
+- (ALTTransactionIdMatch)matchTransactionId:(NSString *)transactionId {
+    if ([self.recentIds containsObject:transactionId]) {
+        return ALTTransactionIdMatchExact;
+    }
+
+    uint16_t fingerprint;
+    NSUInteger firstBucket, secondBucket;
+    [self locate:transactionId fingerprint:&fingerprint firstBucket:&firstBucket secondBucket:&secondBucket];
+
+    for (NSUInteger i = 0; i < kGenerationCount; i++) {
+        if ([self bucket:firstBucket ofGeneration:i contains:fingerprint]
+            || [self bucket:secondBucket ofGeneration:i contains:fingerprint])
+        {
+            return ALTTransactionIdMatchFingerprint;
+        }
+    }
+    return ALTTransactionIdMatchNone;
+}
+
+- (void)addTransactionId:(NSString *)transactionId {
+    @synchronized (self) {
+        if (_counts[_current] >= self.capacity) {
+            [self rotate];
+        }
+
+        uint16_t fingerprint;
+        NSUInteger firstBucket, secondBucket;
+        [self locate:transactionId fingerprint:&fingerprint firstBucket:&firstBucket secondBucket:&secondBucket];
+
+        uint16_t homeless;
+        NSUInteger homelessBucket;
+        if (![self insert:fingerprint
+              firstBucket:firstBucket
+             secondBucket:secondBucket
+                 homeless:&homeless
+           homelessBucket:&homelessBucket])
+        {
+            // unlucky run of collisions, the new fingerprint is in the filter by now, only the
+            // one it displaced last still needs a place, which an empty generation has
+            [self rotate];
+            [self store:homeless inBucket:homelessBucket];
+        }
+
+        [self.recentIds removeObject:transactionId];
+        [self.recentIds addObject:transactionId];
+        if (self.recentIds.count > MIN(self.capacity, kRecentIdCount)) {
+            [self.recentIds removeObjectAtIndex:0];
+        }
+        self.changed = YES;
+    }
+}
+
+- (void)write {
+    if (self.fileName == nil || self.filePath == nil) {
+        return;
+    }
+    @synchronized (self) {
+        // a submitted write that hasn't run yet will pick up this change too
+        if (!self.changed || self.writeSubmitted) {
+            return;
+        }
+        self.writeSubmitted = YES;
+    }
+
+    NSString *filePath = self.filePath;
+    __weak ALTTransactionIdIndex *weakSelf = self;
+    [[ALTStorageWriter sharedWriter]
+     submitWriteForKey:self.fileName
+     block:^BOOL{
+         ALTTransactionIdIndex *strongSelf = weakSelf;
+         if (strongSelf == nil) {
+             return NO;
+         }
+         NSData *data = [strongSelf takeSnapshot];
+         if (![ALTStorageWriter replaceFileAtPath:filePath withData:data]) {
+             [[ALTAlltrackFactory logger] error:@"Failed to write transaction id index"];
+             @synchronized (strongSelf) {
+                 strongSelf.changed = YES;
+             }
+             return NO;
+         }
+         [ALTUtil excludeFromBackup:filePath];
+         return YES;
+     }
+     completion:nil];
+}
+
+- (void)dealloc {
+    for (NSUInteger i = 0; i < kGenerationCount; i++) {
+        free(_slots[i]);
+    }
+}
+
+#pragma mark - private
+
+- (NSData *)takeSnapshot {
+    @synchronized (self) {
+        self.changed = NO;
+        self.writeSubmitted = NO;
+
+        ALTTransactionIdIndexHeader header;
+        header.magic = kFileMagic;
+        header.version = kFileVersion;
+        header.bucketCount = (uint32_t)_bucketCount;
+        header.current = (uint32_t)_current;
+        for (NSUInteger i = 0; i < kGenerationCount; i++) {
+            header.counts[i] = (uint32_t)_counts[i];
+        }
+
+        NSUInteger slotsLength = _bucketCount * kBucketSize * sizeof(uint16_t);
+        NSMutableData *data = [NSMutableData dataWithCapacity:sizeof(header) + slotsLength * kGenerationCount];
+        [data appendBytes:&header length:sizeof(header)];
+        for (NSUInteger i = 0; i < kGenerationCount; i++) {
+            [data appendBytes:_slots[i] length:slotsLength];
+        }
+        for (NSString *transactionId in self.recentIds) {
+            NSData *bytes = [transactionId dataUsingEncoding:NSUTF8StringEncoding];
+            if (bytes == nil || bytes.length > UINT16_MAX) {
+                continue;
+            }
+            uint16_t length = (uint16_t)bytes.length;
+            [data appendBytes:&length length:sizeof(length)];
+            [data appendData:bytes];
+        }
+        return data;
+    }
+}
+
+- (void)read {
+    if (self.filePath == nil) {
+        return;
+    }
+    NSData *data = [NSData dataWithContentsOfFile:self.filePath];
+    if (data == nil) {
+        return;
+    }
+
+    NSUInteger slotsLength = _bucketCount * kBucketSize * sizeof(uint16_t);
+    ALTTransactionIdIndexHeader header;
+    if (data.length < sizeof(header)) {
+        return;
+    }
+    [data getBytes:&header length:sizeof(header)];
+    if (header.magic != kFileMagic || header.version < 1 || header.version > kFileVersion) {
+        [[ALTAlltrackFactory logger] debug:@"Ignoring transaction id index of unknown format"];
+        return;
+    }
+    NSUInteger filterLength = sizeof(header) + slotsLength * kGenerationCount;
+    if (header.bucketCount != _bucketCount
+        || data.length < filterLength
+        || (header.version == 1 && data.length != filterLength))
+    {
+        // fingerprints can't be moved to a filter of another size
+        [[ALTAlltrackFactory logger] debug:@"Transaction id index capacity changed, starting a new one"];
+        return;
+    }
+
+    for (NSUInteger i = 0; i < kGenerationCount; i++) {
+        [data getBytes:_slots[i] range:NSMakeRange(sizeof(header) + slotsLength * i, slotsLength)];
+        _counts[i] = header.counts[i];
+    }
+    _current = header.current % kGenerationCount;
+
+    // a torn list of recent ids only loses the tail, the filter still has their fingerprints
+    const uint8_t *bytes = data.bytes;
+    NSUInteger offset = filterLength;
+    while (offset + sizeof(uint16_t) <= data.length) {
+        uint16_t length;
+        memcpy(&length, bytes + offset, sizeof(length));
+        offset += sizeof(length);
+        if (offset + length > data.length) {
+            break;
+        }
+        NSString *transactionId = [[NSString alloc] initWithBytes:bytes + offset
+                                                           length:length
+                                                         encoding:NSUTF8StringEncoding];
+        offset += length;
+        if (transactionId != nil) {
+            [self.recentIds addObject:transactionId];
+        }
+    }
+    while (self.recentIds.count > MIN(self.capacity, kRecentIdCount)) {
+        [self.recentIds removeObjectAtIndex:0];
+    }
+}
+
+- (void)locate:(NSString *)transactionId
+   fingerprint:(uint16_t *)fingerprint
+   firstBucket:(NSUInteger *)firstBucket
+  secondBucket:(NSUInteger *)secondBucket {
+    uint64_t hash = transactionIdHash(transactionId);
+    uint16_t value = (uint16_t)(hash >> 48);
+    // zero marks an empty slot
+    *fingerprint = value != 0 ? value : 1;
+    *firstBucket = (NSUInteger)(hash & (_bucketCount - 1));
+    *secondBucket = [self alternateBucket:*firstBucket fingerprint:*fingerprint];
+}
+
+- (NSUInteger)alternateBucket:(NSUInteger)bucket fingerprint:(uint16_t)fingerprint {
+    // symmetric, so either bucket leads to the other
+    return (bucket ^ (NSUInteger)((uint32_t)fingerprint * 0x5bd1e995)) & (_bucketCount - 1);
+}
+
+- (BOOL)bucket:(NSUInteger)bucket ofGeneration:(NSUInteger)generation contains:(uint16_t)fingerprint {
+    uint16_t *slots = _slots[generation] + bucket * kBucketSize;
+    for (NSUInteger i = 0; i < kBucketSize; i++) {
+        if (slots[i] == fingerprint) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (BOOL)store:(uint16_t)fingerprint inBucket:(NSUInteger)bucket {
+    uint16_t *slots = _slots[_current] + bucket * kBucketSize;
+    for (NSUInteger i = 0; i < kBucketSize; i++) {
+        if (slots[i] == 0) {
+            slots[i] = fingerprint;
+            _counts[_current]++;
+            return YES;
+        }
+    }
+    return NO;
+}
+
+- (BOOL)insert:(uint16_t)fingerprint
+   firstBucket:(NSUInteger)firstBucket
+  secondBucket:(NSUInteger)secondBucket
+      homeless:(uint16_t *)homeless
+homelessBucket:(NSUInteger *)homelessBucket {
+    if ([self store:fingerprint inBucket:firstBucket] || [self store:fingerprint inBucket:secondBucket]) {
+        return YES;
+    }
+
+    // both buckets full, move existing fingerprints to their alternate buckets
+    NSUInteger bucket = arc4random_uniform(2) == 0 ? firstBucket : secondBucket;
+    for (NSUInteger kick = 0; kick < kMaxKicks; kick++) {
+        uint16_t *slot = _slots[_current] + bucket * kBucketSize + arc4random_uniform((uint32_t)kBucketSize);
+        uint16_t evicted = *slot;
+        *slot = fingerprint;
+        fingerprint = evicted;
+        bucket = [self alternateBucket:bucket fingerprint:fingerprint];
+        if ([self store:fingerprint inBucket:bucket]) {
+            return YES;
+        }
+    }
+    // the last evicted fingerprint and the bucket it belongs to, it has no place left
+    *homeless = fingerprint;
+    *homelessBucket = bucket;
+    return NO;
+}
+
+- (void)rotate {
+    _current = (_current + 1) % kGenerationCount;
+    memset(_slots[_current], 0, _bucketCount * kBucketSize * sizeof(uint16_t));
+    _counts[_current] = 0;
+    self.changed = YES;
+}
+
+@end
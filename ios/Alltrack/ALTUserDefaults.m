@@ -1,5 +1,8 @@
+#include <stdatomic.h>
+
 #import "ALTUserDefaults.h"
 
+static NSString * const PREFS_KEY_FLAGS = @"alt_flags";
 static NSString * const PREFS_KEY_PUSH_TOKEN_DATA = @"alt_push_token";
 static NSString * const PREFS_KEY_PUSH_TOKEN_STRING = @"alt_push_token_string";
 static NSString * const PREFS_KEY_GDPR_FORGET_ME = @"alt_gdpr_forget_me";
@@ -12,9 +15,59 @@ static NSString * const PREFS_KEY_ADSERVICES_TRACKED = @"alt_adservices_tracked"
 static NSString * const PREFS_KEY_SKAD_REGISTER_CALL_TIME = @"alt_skad_register_call_time";
 static NSString * const PREFS_KEY_LINK_ME_CHECKED = @"alt_link_me_checked";
 static NSString * const PREFS_KEY_DEEPLINK_URL_CACHED = @"alt_deeplink_url_cached";
+static const char * const kFlagsQueueName = "io.alltrack.UserDefaultsFlags";
+
+// boolean preferences, packed into the single PREFS_KEY_FLAGS value
+typedef NS_OPTIONS(uint32_t, ALTUserDefaultsFlag) {
+    ALTUserDefaultsFlagInstallTracked = 1 << 0,
+    ALTUserDefaultsFlagGdprForgetMe = 1 << 1,
+    ALTUserDefaultsFlagDisableThirdPartySharing = 1 << 2,
+    ALTUserDefaultsFlagAdServicesTracked = 1 << 3,
+    ALTUserDefaultsFlagLinkMeChecked = 1 << 4
+};
+
+static atomic_uint_fast32_t flags;
+static atomic_bool flagsWriteScheduled;
+static dispatch_queue_t flagsQueue;
 
 @implementation ALTUserDefaults
 
++ (void)initialize {
+    if (self != [ALTUserDefaults class]) {
+        return;
+    }
+
+    atomic_init(&flagsWriteScheduled, false);
+    flagsQueue = dispatch_queue_create(kFlagsQueueName, DISPATCH_QUEUE_SERIAL);
+
+    NSUserDefaults *userDefaults = [NSUserDefaults standardUserDefaults];
+    id storedFlags = [userDefaults objectForKey:PREFS_KEY_FLAGS];
+    if ([storedFlags isKindOfClass:[NSNumber class]]) {
+        atomic_init(&flags, [storedFlags unsignedIntValue]);
+        return;
+    }
+
+    // first run with packed flags, move the separate keys over once
+    NSDictionary<NSString *, NSNumber *> *legacyKeys = @{
+        PREFS_KEY_INSTALL_TRACKED: @(ALTUserDefaultsFlagInstallTracked),
+        PREFS_KEY_GDPR_FORGET_ME: @(ALTUserDefaultsFlagGdprForgetMe),
+        PREFS_KEY_DISABLE_THIRD_PARTY_SHARING: @(ALTUserDefaultsFlagDisableThirdPartySharing),
+        PREFS_KEY_ADSERVICES_TRACKED: @(ALTUserDefaultsFlagAdServicesTracked),
+        PREFS_KEY_LINK_ME_CHECKED: @(ALTUserDefaultsFlagLinkMeChecked)
+    };
+    uint32_t migratedFlags = 0;
+    for (NSString *key in legacyKeys) {
+        if ([userDefaults boolForKey:key]) {
+            migratedFlags |= [legacyKeys[key] unsignedIntValue];
+        }
+    }
+    atomic_init(&flags, migratedFlags);
+    [userDefaults setObject:@(migratedFlags) forKey:PREFS_KEY_FLAGS];
+    for (NSString *key in legacyKeys) {
+        [userDefaults removeObjectForKey:key];
+    }
+}
+
 #pragma mark - Public methods
 
 + (void)savePushTokenData:(NSData *)pushToken {
@@ -39,23 +92,23 @@ static NSString * const PREFS_KEY_DEEPLINK_URL_CACHED = @"alt_deeplink_url_cache
 }
 
 + (void)setInstallTracked {
-    [[NSUserDefaults standardUserDefaults] setBool:YES forKey:PREFS_KEY_INSTALL_TRACKED];
+    [self setFlag:ALTUserDefaultsFlagInstallTracked];
 }
 
 + (BOOL)getInstallTracked {
-    return [[NSUserDefaults standardUserDefaults] boolForKey:PREFS_KEY_INSTALL_TRACKED];
+    return [self getFlag:ALTUserDefaultsFlagInstallTracked];
 }
 
 + (void)setGdprForgetMe {
-    [[NSUserDefaults standardUserDefaults] setBool:YES forKey:PREFS_KEY_GDPR_FORGET_ME];
+    [self setFlag:ALTUserDefaultsFlagGdprForgetMe];
 }
 
 + (BOOL)getGdprForgetMe {
-    return [[NSUserDefaults standardUserDefaults] boolForKey:PREFS_KEY_GDPR_FORGET_ME];
+    return [self getFlag:ALTUserDefaultsFlagGdprForgetMe];
 }
 
 + (void)removeGdprForgetMe {
-    [[NSUserDefaults standardUserDefaults] removeObjectForKey:PREFS_KEY_GDPR_FORGET_ME];
+    [self clearFlag:ALTUserDefaultsFlagGdprForgetMe];
 }
 
 + (void)saveDeeplinkUrl:(NSURL *)deeplink andClickTime:(NSDate *)clickTime {
@@ -77,15 +130,15 @@ static NSString * const PREFS_KEY_DEEPLINK_URL_CACHED = @"alt_deeplink_url_cache
 }
 
 + (void)setDisableThirdPartySharing {
-    [[NSUserDefaults standardUserDefaults] setBool:YES forKey:PREFS_KEY_DISABLE_THIRD_PARTY_SHARING];
+    [self setFlag:ALTUserDefaultsFlagDisableThirdPartySharing];
 }
 
 + (BOOL)getDisableThirdPartySharing {
-    return [[NSUserDefaults standardUserDefaults] boolForKey:PREFS_KEY_DISABLE_THIRD_PARTY_SHARING];
+    return [self getFlag:ALTUserDefaultsFlagDisableThirdPartySharing];
 }
 
 + (void)removeDisableThirdPartySharing {
-    [[NSUserDefaults standardUserDefaults] removeObjectForKey:PREFS_KEY_DISABLE_THIRD_PARTY_SHARING];
+    [self clearFlag:ALTUserDefaultsFlagDisableThirdPartySharing];
 }
 
 + (void)saveiAdErrorKey:(NSString *)key {
@@ -117,11 +170,11 @@ static NSString * const PREFS_KEY_DEEPLINK_URL_CACHED = @"alt_deeplink_url_cache
 }
 
 + (void)setAdServicesTracked {
-    [[NSUserDefaults standardUserDefaults] setBool:YES forKey:PREFS_KEY_ADSERVICES_TRACKED];
+    [self setFlag:ALTUserDefaultsFlagAdServicesTracked];
 }
 
 + (BOOL)getAdServicesTracked {
-    return [[NSUserDefaults standardUserDefaults] boolForKey:PREFS_KEY_ADSERVICES_TRACKED];
+    return [self getFlag:ALTUserDefaultsFlagAdServicesTracked];
 }
 
 + (void)saveSkadRegisterCallTimestamp:(NSDate *)callTime {
@@ -133,11 +186,11 @@ static NSString * const PREFS_KEY_DEEPLINK_URL_CACHED = @"alt_deeplink_url_cache
 }
 
 + (void)setLinkMeChecked {
-    [[NSUserDefaults standardUserDefaults] setBool:YES forKey:PREFS_KEY_LINK_ME_CHECKED];
+    [self setFlag:ALTUserDefaultsFlagLinkMeChecked];
 }
 
 + (BOOL)getLinkMeChecked {
-    return [[NSUserDefaults standardUserDefaults] boolForKey:PREFS_KEY_LINK_ME_CHECKED];
+    return [self getFlag:ALTUserDefaultsFlagLinkMeChecked];
 }
 
 + (void)cacheDeeplinkUrl:(NSURL *)deeplink {
@@ -149,6 +202,8 @@ static NSString * const PREFS_KEY_DEEPLINK_URL_CACHED = @"alt_deeplink_url_cache
 }
 
 + (void)clearAlltrackStuff {
+    atomic_store(&flags, 0);
+    [self scheduleFlagsWrite];
     [[NSUserDefaults standardUserDefaults] removeObjectForKey:PREFS_KEY_PUSH_TOKEN_DATA];
     [[NSUserDefaults standardUserDefaults] removeObjectForKey:PREFS_KEY_PUSH_TOKEN_STRING];
     [[NSUserDefaults standardUserDefaults] removeObjectForKey:PREFS_KEY_INSTALL_TRACKED];
@@ -163,4 +218,36 @@ static NSString * const PREFS_KEY_DEEPLINK_URL_CACHED = @"alt_deeplink_url_cache
     [[NSUserDefaults standardUserDefaults] removeObjectForKey:PREFS_KEY_DEEPLINK_URL_CACHED];
 }
 
+#pragma mark - Private methods
+
++ (BOOL)getFlag:(ALTUserDefaultsFlag)flag {
+    return (atomic_load(&flags) & flag) != 0;
+}
+
++ (void)setFlag:(ALTUserDefaultsFlag)flag {
+    uint32_t previous = (uint32_t)atomic_fetch_or(&flags, flag);
+    if ((previous & flag) == 0) {
+        [self scheduleFlagsWrite];
+    }
+}
+
++ (void)clearFlag:(ALTUserDefaultsFlag)flag {
+    uint32_t previous = (uint32_t)atomic_fetch_and(&flags, ~flag);
+    if ((previous & flag) != 0) {
+        [self scheduleFlagsWrite];
+    }
+}
+
++ (void)scheduleFlagsWrite {
+    // changes made before the write runs are written together
+    if (atomic_exchange(&flagsWriteScheduled, true)) {
+        return;
+    }
+    dispatch_async(flagsQueue, ^{
+        atomic_store(&flagsWriteScheduled, false);
+        uint32_t value = (uint32_t)atomic_load(&flags);
+        [[NSUserDefaults standardUserDefaults] setObject:@(value) forKey:PREFS_KEY_FLAGS];
+    });
+}
+
 @end
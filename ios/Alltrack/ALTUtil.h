@@ -23,6 +23,10 @@ typedef void (^isInactiveInjected)(BOOL);
 
 + (void)excludeFromBackup:(NSString *)filename;
 
++ (NSString *)getFilePathInDocumentsDir:(NSString *)fileName;
+
++ (NSString *)getFilePathInAppSupportDir:(NSString *)fileName;
+
 + (void)launchDeepLinkMain:(NSURL *)deepLinkUrl NS_EXTENSION_UNAVAILABLE_IOS("");
 
 + (void)launchInMainThread:(dispatch_block_t)block;
@@ -40,6 +44,10 @@ typedef void (^isInactiveInjected)(BOOL);
          objectName:(NSString *)objectName
          syncObject:(id)syncObject;
 
++ (NSData *)archiveObject:(id)object;
+
++ (id)unarchiveData:(NSData *)data class:(Class)classToRead;
+
 + (void)launchInMainThread:(NSObject *)receiver
                   selector:(SEL)selector
                 withObject:(id)object;
@@ -48,6 +56,10 @@ typedef void (^isInactiveInjected)(BOOL);
            selfInject:(id)selfInject
                 block:(selfInjectedBlock)block;
 
++ (void)launchInOwnQueue:(dispatch_queue_t)queue
+              selfInject:(id)selfInject
+                   block:(selfInjectedBlock)block;
+
 + (void)launchSynchronisedWithObject:(id)synchronisationObject
                                block:(synchronisedBlock)block;
 
@@ -14,7 +14,9 @@
 #import "ALTLogger.h"
 #import "ALTResponseData.h"
 #import "ALTAlltrackFactory.h"
+#import "ALTExecutor.h"
 #import "NSString+ALTAdditions.h"
+#import "ALTLinkMatcher.h"
 
 #if !ALLTRACK_NO_IDFA
 #import <AdSupport/ASIdentifierManager.h>
@@ -25,20 +27,12 @@
 #endif
 
 static NSString *userAgent = nil;
-static NSRegularExpression *universalLinkRegex = nil;
 static NSNumberFormatter *secondsNumberFormatter = nil;
-static NSRegularExpression *optionalRedirectRegex = nil;
-static NSRegularExpression *shortUniversalLinkRegex = nil;
-static NSRegularExpression *excludedDeeplinkRegex = nil;
 
 static NSString * const kClientSdk                  = @"ios0.0.1";
 static NSString * const kDeeplinkParam              = @"deep_link=";
 static NSString * const kSchemeDelimiter            = @"://";
 static NSString * const kDefaultScheme              = @"AlltrackUniversalScheme";
-static NSString * const kUniversalLinkPattern       = @"https://[^.]*\\.ulink\\.alltrack\\.com/ulink/?(.*)";
-static NSString * const kOptionalRedirectPattern    = @"alltrack_redirect=[^&#]*";
-static NSString * const kShortUniversalLinkPattern  = @"http[s]?://[a-z0-9]{4}\\.(?:[a-z]{2}\\.)?alt\\.st/?(.*)";
-static NSString * const kExcludedDeeplinksPattern   = @"^(fb|vk)[0-9]{5,}[^:]*://authorize.*access_token=.*";
 static NSString * const kDateFormat                 = @"yyyy-MM-dd'T'HH:mm:ss.SSS'Z'Z";
 
 @implementation ALTUtil
@@ -48,66 +42,12 @@ static NSString * const kDateFormat                 = @"yyyy-MM-dd'T'HH:mm:ss.SS
         return;
     }
 
-    [self initializeUniversalLinkRegex];
     [self initializeSecondsNumberFormatter];
-    [self initializeShortUniversalLinkRegex];
-    [self initializeOptionalRedirectRegex];
-    [self initializeExcludedDeeplinkRegex];
 }
 
 + (void)teardown {
-    universalLinkRegex = nil;
     secondsNumberFormatter = nil;
-    optionalRedirectRegex = nil;
-    shortUniversalLinkRegex = nil;
-}
-
-+ (void)initializeUniversalLinkRegex {
-    NSError *error = NULL;
-    NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:kUniversalLinkPattern
-                                                                           options:NSRegularExpressionCaseInsensitive
-                                                                             error:&error];
-    if ([ALTUtil isNotNull:error]) {
-        [ALTAlltrackFactory.logger error:@"Universal link regex rule error (%@)", [error description]];
-        return;
-    }
-    universalLinkRegex = regex;
-}
-
-+ (void)initializeShortUniversalLinkRegex {
-    NSError *error = NULL;
-    NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:kShortUniversalLinkPattern
-                                                                           options:NSRegularExpressionCaseInsensitive
-                                                                             error:&error];
-    if ([ALTUtil isNotNull:error]) {
-        [ALTAlltrackFactory.logger error:@"Short Universal link regex rule error (%@)", [error description]];
-        return;
-    }
-    shortUniversalLinkRegex = regex;
-}
-
-+ (void)initializeOptionalRedirectRegex {
-    NSError *error = NULL;
-    NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:kOptionalRedirectPattern
-                                                                           options:NSRegularExpressionCaseInsensitive
-                                                                             error:&error];
-    if ([ALTUtil isNotNull:error]) {
-        [ALTAlltrackFactory.logger error:@"Optional redirect regex rule error (%@)", [error description]];
-        return;
-    }
-    optionalRedirectRegex = regex;
-}
-
-+ (void)initializeExcludedDeeplinkRegex {
-    NSError *error = NULL;
-    NSRegularExpression *regex = [NSRegularExpression regularExpressionWithPattern:kExcludedDeeplinksPattern
-                                                                           options:NSRegularExpressionCaseInsensitive
-                                                                             error:&error];
-    if ([ALTUtil isNotNull:error]) {
-        [ALTAlltrackFactory.logger error:@"Excluded deep link regex rule error (%@)", [error description]];
-        return;
-    }
-    excludedDeeplinkRegex = regex;
+    [ALTExecutor teardown];
 }
 
 + (void)initializeSecondsNumberFormatter {
@@ -360,6 +300,62 @@ static NSString * const kDateFormat                 = @"yyyy-MM-dd'T'HH:mm:ss.SS
     }
 }
 
++ (NSData *)archiveObject:(id)object {
+    NSData *data = nil;
+    @try {
+        if (@available(iOS 11.0, tvOS 11.0, *)) {
+            NSError *errorArchiving = nil;
+            // API introduced in iOS 11.
+            data = [NSKeyedArchiver archivedDataWithRootObject:object requiringSecureCoding:NO error:&errorArchiving];
+            if (errorArchiving != nil) {
+                data = nil;
+            }
+        } else {
+            // API_DEPRECATED [2.0-12.0]
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+            data = [NSKeyedArchiver archivedDataWithRootObject:object];
+#pragma clang diagnostic pop
+        }
+    } @catch (NSException *exception) {
+        [[ALTAlltrackFactory logger] error:@"Failed to archive object (%@)", exception];
+        data = nil;
+    }
+    return data;
+}
+
++ (id)unarchiveData:(NSData *)data class:(Class)classToRead {
+    if (data == nil) {
+        return nil;
+    }
+    id object = nil;
+    @try {
+        if (@available(iOS 11.0, tvOS 11.0, *)) {
+            NSError *errorUnarchiver = nil;
+            // API introduced in iOS 11.
+            NSKeyedUnarchiver *unarchiver = [[NSKeyedUnarchiver alloc] initForReadingFromData:data
+                                                                                        error:&errorUnarchiver];
+            if (errorUnarchiver == nil) {
+                [unarchiver setRequiresSecureCoding:NO];
+                object = [unarchiver decodeObjectOfClass:classToRead forKey:NSKeyedArchiveRootObjectKey];
+            }
+        } else {
+            // API_DEPRECATED [2.0-12.0]
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wdeprecated-declarations"
+            object = [NSKeyedUnarchiver unarchiveObjectWithData:data];
+#pragma clang diagnostic pop
+        }
+    } @catch (NSException *exception) {
+        [[ALTAlltrackFactory logger] error:@"Failed to unarchive object (%@)", exception];
+        object = nil;
+    }
+    if (object != nil && ![object isKindOfClass:classToRead]) {
+        return nil;
+    }
+    return object;
+}
+
 + (BOOL)migrateFileFromPath:(NSString *)oldPath toPath:(NSString *)newPath {
     __autoreleasing NSError *error;
     __autoreleasing NSError **errorPointer = &error;
@@ -573,35 +569,16 @@ static NSString * const kDateFormat                 = @"yyyy-MM-dd'T'HH:mm:ss.SS
         [logger error:@"Parsed universal link is nil"];
         return nil;
     }
-    if (universalLinkRegex == nil) {
-        [logger error:@"Universal link regex not correctly configured"];
-        return nil;
-    }
-    if (shortUniversalLinkRegex == nil) {
-        [logger error:@"Short Universal link regex not correctly configured"];
-        return nil;
-    }
-
-    NSArray<NSTextCheckingResult *> *matches = [universalLinkRegex matchesInString:urlString options:0 range:NSMakeRange(0, [urlString length])];
-    if ([matches count] == 0) {
-        matches = [shortUniversalLinkRegex matchesInString:urlString options:0 range:NSMakeRange(0, [urlString length])];
-        if ([matches count] == 0) {
+    NSRange tailRange = [ALTLinkMatcher universalLinkTailRangeInString:urlString];
+    if (tailRange.location == NSNotFound) {
+        tailRange = [ALTLinkMatcher shortUniversalLinkTailRangeInString:urlString];
+        if (tailRange.location == NSNotFound) {
             [logger error:@"Url doesn't match as universal link or short version"];
             return nil;
         }
     }
-    if ([matches count] > 1) {
-        [logger error:@"Url match as universal link multiple times"];
-        return nil;
-    }
 
-    NSTextCheckingResult *match = matches[0];
-    if ([match numberOfRanges] != 2) {
-        [logger error:@"Wrong number of ranges matched"];
-        return nil;
-    }
-
-    NSString *tailSubString = [urlString substringWithRange:[match rangeAtIndex:1]];
+    NSString *tailSubString = [urlString substringWithRange:tailRange];
     NSString *finalTailSubString = [ALTUtil removeOptionalRedirect:tailSubString];
     NSString *extractedUrlString = [NSString stringWithFormat:@"%@://%@", scheme, finalTailSubString];
     [logger info:@"Converted deeplink from universal link %@", extractedUrlString];
@@ -616,24 +593,18 @@ static NSString * const kDateFormat                 = @"yyyy-MM-dd'T'HH:mm:ss.SS
 + (NSString *)removeOptionalRedirect:(NSString *)tailSubString {
     id<ALTLogger> logger = ALTAlltrackFactory.logger;
 
-    if (optionalRedirectRegex == nil) {
-        [ALTAlltrackFactory.logger error:@"Remove Optional Redirect regex not correctly configured"];
-        return tailSubString;
-    }
-    NSArray<NSTextCheckingResult *> *optionalRedirectmatches = [optionalRedirectRegex matchesInString:tailSubString
-                                                                                              options:0
-                                                                                                range:NSMakeRange(0, [tailSubString length])];
-    if ([optionalRedirectmatches count] == 0) {
+    NSRange redirectRange;
+    NSUInteger redirectMatchCount = [ALTLinkMatcher optionalRedirectMatchesInString:tailSubString
+                                                                         firstRange:&redirectRange];
+    if (redirectMatchCount == 0) {
         [logger debug:@"Universal link does not contain option alltrack_redirect parameter"];
         return tailSubString;
     }
-    if ([optionalRedirectmatches count] > 1) {
+    if (redirectMatchCount > 1) {
         [logger error:@"Universal link contains multiple option alltrack_redirect parameters"];
         return tailSubString;
     }
 
-    NSTextCheckingResult *redirectMatch = optionalRedirectmatches[0];
-    NSRange redirectRange = [redirectMatch rangeAtIndex:0];
     NSString *beforeRedirect = [tailSubString substringToIndex:redirectRange.location];
     NSString *afterRedirect = [tailSubString substringFromIndex:(redirectRange.location + redirectRange.length)];
     if (beforeRedirect.length > 0 && afterRedirect.length > 0) {
@@ -798,7 +769,9 @@ static NSString * const kDateFormat                 = @"yyyy-MM-dd'T'HH:mm:ss.SS
         return;
     }
     __weak __typeof__(selfInject) weakSelf = selfInject;
+    uint64_t enqueuedAt = [ALTExecutor timestamp];
     dispatch_async(queue, ^{
+        [ALTExecutor recordSchedulingLatencySince:enqueuedAt];
         __typeof__(selfInject) strongSelf = weakSelf;
         if (strongSelf == nil) {
             return;
@@ -807,6 +780,23 @@ static NSString * const kDateFormat                 = @"yyyy-MM-dd'T'HH:mm:ss.SS
     });
 }
 
+// Runs the block right away when already on the queue, otherwise it is dispatched like launchInQueue.
++ (void)launchInOwnQueue:(dispatch_queue_t)queue
+              selfInject:(id)selfInject
+                   block:(selfInjectedBlock)block {
+    if (queue == nil) {
+        return;
+    }
+    if (![ALTExecutor isRunningOnMailbox:queue]) {
+        [ALTUtil launchInQueue:queue selfInject:selfInject block:block];
+        return;
+    }
+    if (selfInject == nil) {
+        return;
+    }
+    block(selfInject);
+}
+
 + (void)launchSynchronisedWithObject:(id)synchronisationObject
                                block:(synchronisedBlock)block {
     @synchronized (synchronisationObject) {
@@ -1004,16 +994,8 @@ static NSString * const kDateFormat                 = @"yyyy-MM-dd'T'HH:mm:ss.SS
     if ([[url absoluteString] length] == 0) {
         return NO;
     }
-    if (excludedDeeplinkRegex == nil) {
-        [ALTAlltrackFactory.logger error:@"Excluded deep link regex not correctly configured"];
-        return NO;
-    }
-
     NSString *urlString = [url absoluteString];
-    NSArray<NSTextCheckingResult *> *matches = [excludedDeeplinkRegex matchesInString:urlString
-                                                                              options:0
-                                                                                range:NSMakeRange(0, [urlString length])];
-    if ([matches count] > 0) {
+    if ([ALTLinkMatcher isExcludedDeeplink:urlString]) {
         [ALTAlltrackFactory.logger debug:@"Deep link (%@) processing skipped", urlString];
         return NO;
     }
@@ -614,7 +614,11 @@ static dispatch_once_t onceToken = 0;
     if (![self checkActivityHandler]) {
         return nil;
     }
-    return [self.activityHandler attribution];
+    ALTStateSnapshot *snapshot = [self.activityHandler stateSnapshot];
+    if (snapshot == nil) {
+        return [self.activityHandler attribution];
+    }
+    return snapshot.attribution;
 }
 
 - (NSString *)adid {
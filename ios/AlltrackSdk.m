@@ -35,6 +35,7 @@ RCT_EXPORT_METHOD(create:(NSDictionary *)dict) {
     NSNumber *needsCost = dict[@"needsCost"];
     NSNumber *shouldLaunchDeeplink = dict[@"shouldLaunchDeeplink"];
     NSNumber *delayStart = dict[@"delayStart"];
+    NSNumber *transactionIdDedupCapacity = dict[@"transactionIdDedupCapacity"];
     NSNumber *isDeviceKnown = dict[@"isDeviceKnown"];
     NSNumber *allowiAdInfoReading = dict[@"allowiAdInfoReading"];
     NSNumber *allowAdServicesInfoReading = dict[@"allowAdServicesInfoReading"];
@@ -42,6 +43,7 @@ RCT_EXPORT_METHOD(create:(NSDictionary *)dict) {
     NSNumber *skAdNetworkHandling = dict[@"skAdNetworkHandling"];
     NSNumber *coppaCompliantEnabled = dict[@"coppaCompliantEnabled"];
     NSNumber *linkMeEnabled = dict[@"linkMeEnabled"];
+    NSNumber *requestBodyCompressionEnabled = dict[@"requestBodyCompressionEnabled"];
     BOOL allowSuppressLogLevel = NO;
 
     // Suppress log level.
@@ -180,6 +182,11 @@ RCT_EXPORT_METHOD(create:(NSDictionary *)dict) {
         [alltrackConfig setDelayStart:[delayStart doubleValue]];
     }
 
+    // Transaction ID deduplication.
+    if ([self isFieldValid:transactionIdDedupCapacity]) {
+        [alltrackConfig setTransactionIdDedupCapacity:[transactionIdDedupCapacity unsignedIntegerValue]];
+    }
+
     // COPPA compliance.
     if ([self isFieldValid:coppaCompliantEnabled]) {
         [alltrackConfig setCoppaCompliantEnabled:[coppaCompliantEnabled boolValue]];
@@ -190,6 +197,11 @@ RCT_EXPORT_METHOD(create:(NSDictionary *)dict) {
         [alltrackConfig setLinkMeEnabled:[linkMeEnabled boolValue]];
     }
 
+    // Request body compression.
+    if ([self isFieldValid:requestBodyCompressionEnabled]) {
+        [alltrackConfig setRequestBodyCompressionEnabled:[requestBodyCompressionEnabled boolValue]];
+    }
+
     // Start SDK.
     [Alltrack appDidLaunch:alltrackConfig];
     [Alltrack trackSubsessionStart];